@@ -0,0 +1,137 @@
+// Times reading a directory of 100k entries with ImageList::get_entries against the way it
+// used to be done, where every file name was checked against every gdk-pixbuf format's
+// extension list (allocated and freed again for each file)
+#include "imagelist.h"
+using namespace AhoViewer;
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <giomm.h>
+#include <glib/gstdio.h>
+#include <iterator>
+
+static constexpr size_t EntryCount{ 100000 }, Runs{ 3 };
+
+static bool is_valid_extension_per_file(const std::string& path)
+{
+    std::string ext{ path.substr(path.find_last_of('.') + 1) };
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+#ifdef HAVE_GSTREAMER
+    if (ext == "webm" || ext == "mp4")
+        return true;
+#endif // HAVE_GSTREAMER
+
+    bool r = false;
+
+    for (Gdk::PixbufFormat i : Gdk::Pixbuf::get_formats())
+    {
+        gchar** extensions = gdk_pixbuf_format_get_extensions(i.gobj());
+        for (int j = 0; extensions[j] != nullptr; ++j)
+        {
+            if (strcmp(ext.c_str(), extensions[j]) == 0)
+                r = true;
+        }
+
+        g_strfreev(extensions);
+    }
+
+    return r;
+}
+
+static std::vector<std::string> get_entries_per_file(const std::string& path)
+{
+    Glib::Dir dir(path);
+    std::vector<std::string> entries(dir.begin(), dir.end());
+    auto i = entries.begin();
+
+    while (i != entries.end())
+    {
+        *i = Glib::build_filename(path, *i);
+
+        if (is_valid_extension_per_file(*i))
+            ++i;
+        else
+            i = entries.erase(i);
+    }
+
+    return entries;
+}
+
+// Best of Runs, in milliseconds
+template<typename F>
+static double best_time(F&& f, std::vector<std::string>& entries)
+{
+    double best{ 0 };
+
+    for (size_t i = 0; i < Runs; ++i)
+    {
+        const auto start{ std::chrono::steady_clock::now() };
+        entries = f();
+        const double ms{
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                .count()
+        };
+
+        if (i == 0 || ms < best)
+            best = ms;
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    return best;
+}
+
+int main()
+{
+    Gio::init();
+
+    gchar* tmp_dir{ g_dir_make_tmp("ahoviewer-bench-XXXXXX", nullptr) };
+    if (!tmp_dir)
+    {
+        std::fprintf(stderr, "Failed to create a temporary directory\n");
+        return EXIT_FAILURE;
+    }
+    const std::string dir_path{ tmp_dir };
+    g_free(tmp_dir);
+
+    // Mostly images, some files that are skipped and a few directories.  The directories
+    // don't have an image extension so both ways return the same entries
+    static constexpr const char* Extensions[]{ ".jpg", ".png", ".gif", ".JPG", ".txt", "" };
+    std::vector<std::string> paths;
+
+    paths.reserve(EntryCount);
+    for (size_t i = 0; i < EntryCount; ++i)
+    {
+        const bool is_dir{ i % 50 == 0 };
+        const std::string path{ Glib::build_filename(
+            dir_path,
+            (is_dir ? "dir" : "entry") + std::to_string(i) +
+                (is_dir ? "" : Extensions[i % std::size(Extensions)])) };
+
+        if (is_dir)
+            g_mkdir(path.c_str(), 0700);
+        else
+            g_close(g_creat(path.c_str(), 0600), nullptr);
+
+        paths.push_back(path);
+    }
+
+    std::vector<std::string> old_entries, entries;
+    const double old_ms{ best_time([&]() { return get_entries_per_file(dir_path); },
+                                   old_entries) },
+        ms{ best_time([&]() { return ImageList::get_entries<Image>(dir_path); }, entries) };
+
+    std::printf("%zu entries, %zu images\n", EntryCount, entries.size());
+    std::printf("Extension lists per file: %9.2f ms\n", old_ms);
+    std::printf("ImageList::get_entries:   %9.2f ms\n", ms);
+
+    for (auto it = paths.rbegin(); it != paths.rend(); ++it)
+        g_remove(it->c_str());
+    g_rmdir(dir_path.c_str());
+
+    return entries == old_entries ? EXIT_SUCCESS : EXIT_FAILURE;
+}
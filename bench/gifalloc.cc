@@ -0,0 +1,251 @@
+// Counts the heap allocations made while an animated GIF plays once the frame ring has filled.
+// Showing a frame and decoding the next one into a reused pixbuf shouldn't allocate at all
+// when the frames are shown at their own size.  Scaled frames are only reported, the
+// resampler allocates its filter tables and intermediate rows for every frame
+#include "image.h"
+using namespace AhoViewer;
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <gdkmm/wrap_init.h>
+#include <giomm.h>
+#include <glib/gstdio.h>
+#include <thread>
+#include <vector>
+
+static std::atomic<bool> Counting{ false };
+static std::atomic<size_t> Allocations{ 0 };
+
+#ifdef __GLIBC__
+// Everything (including gdk-pixbuf and GLib) ends up here, operator new included
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+
+    void* malloc(size_t size)
+    {
+        if (Counting.load(std::memory_order_relaxed))
+            ++Allocations;
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t n, size_t size)
+    {
+        if (Counting.load(std::memory_order_relaxed))
+            ++Allocations;
+        return __libc_calloc(n, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        if (Counting.load(std::memory_order_relaxed))
+            ++Allocations;
+        return __libc_realloc(ptr, size);
+    }
+}
+#else  // !__GLIBC__
+// Only C++ allocations are seen
+void* operator new(size_t size)
+{
+    if (Counting.load(std::memory_order_relaxed))
+        ++Allocations;
+    if (void* p{ std::malloc(size ? size : 1) })
+        return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+#endif // !__GLIBC__
+
+static constexpr int Width{ 480 }, Height{ 270 };
+static constexpr size_t FrameCount{ 24 }, WarmupLoops{ 2 }, CountedLoops{ 10 };
+
+// LZW codes are written 9 bits wide with a clear code before the table would need 10 bits,
+// so the GIF is about as big as the raw pixels but the writer stays trivial
+class CodeWriter
+{
+public:
+    CodeWriter(std::vector<uint8_t>& out) : m_Out{ out } { }
+
+    void put(const uint32_t code)
+    {
+        m_Bits |= code << m_BitCount;
+        m_BitCount += 9;
+
+        for (; m_BitCount >= 8; m_BitCount -= 8, m_Bits >>= 8)
+            put_byte(m_Bits & 0xFF);
+    }
+
+    void finish()
+    {
+        if (m_BitCount > 0)
+            put_byte(m_Bits & 0xFF);
+        if (!m_Block.empty())
+            flush_block();
+        m_Out.push_back(0);
+    }
+
+private:
+    void put_byte(const uint8_t b)
+    {
+        m_Block.push_back(b);
+        if (m_Block.size() == 255)
+            flush_block();
+    }
+
+    void flush_block()
+    {
+        m_Out.push_back(static_cast<uint8_t>(m_Block.size()));
+        m_Out.insert(m_Out.end(), m_Block.begin(), m_Block.end());
+        m_Block.clear();
+    }
+
+    std::vector<uint8_t>& m_Out;
+    std::vector<uint8_t> m_Block;
+    uint32_t m_Bits{ 0 }, m_BitCount{ 0 };
+};
+
+static void put_u16(std::vector<uint8_t>& out, const uint16_t v)
+{
+    out.push_back(v & 0xFF);
+    out.push_back(v >> 8);
+}
+
+// A looping animation of a moving 256 color gradient
+static std::vector<uint8_t> create_gif()
+{
+    static constexpr uint32_t ClearCode{ 256 }, EndCode{ 257 }, MaxRun{ 254 };
+    std::vector<uint8_t> out{ 'G', 'I', 'F', '8', '9', 'a' };
+
+    put_u16(out, Width);
+    put_u16(out, Height);
+    // Global color table with 256 entries
+    out.insert(out.end(), { 0xF7, 0, 0 });
+    for (int i = 0; i < 256; ++i)
+        out.insert(out.end(),
+                   { static_cast<uint8_t>(i), static_cast<uint8_t>(255 - i),
+                     static_cast<uint8_t>(i * 3) });
+
+    const char loop[]{ "NETSCAPE2.0" };
+    out.insert(out.end(), { 0x21, 0xFF, 11 });
+    out.insert(out.end(), loop, loop + 11);
+    out.insert(out.end(), { 3, 1, 0, 0, 0 });
+
+    for (size_t f = 0; f < FrameCount; ++f)
+    {
+        // Graphic control extension, no disposal and a 20ms delay
+        out.insert(out.end(), { 0x21, 0xF9, 4, 0x04, 2, 0, 0, 0 });
+        out.push_back(0x2C);
+        put_u16(out, 0);
+        put_u16(out, 0);
+        put_u16(out, Width);
+        put_u16(out, Height);
+        out.push_back(0);
+        out.push_back(8);
+
+        CodeWriter codes{ out };
+        uint32_t run{ MaxRun };
+        for (int y = 0; y < Height; ++y)
+        {
+            for (int x = 0; x < Width; ++x, ++run)
+            {
+                if (run == MaxRun)
+                {
+                    codes.put(ClearCode);
+                    run = 0;
+                }
+                codes.put((x + y + f * 8) & 0xFF);
+            }
+        }
+        codes.put(EndCode);
+        codes.finish();
+    }
+
+    out.push_back(0x3B);
+
+    return out;
+}
+
+// Returns the number of allocations made while showing CountedLoops loops of the animation
+static size_t play(const std::string& path, const int w, const int h, double& ms_per_frame)
+{
+    Image image{ path };
+    image.load_pixbuf(Gio::Cancellable::create());
+
+    if (!image.is_animated_gif())
+    {
+        std::fprintf(stderr, "Failed to load the animation\n");
+        std::exit(EXIT_FAILURE);
+    }
+
+    image.set_gif_frame_size(w, h);
+    image.start_gif_decoder();
+
+    auto advance{ [&]() {
+        while (!image.gif_advance_frame())
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    } };
+
+    for (size_t i = 0; i < FrameCount * WarmupLoops; ++i)
+        advance();
+
+    const auto start{ std::chrono::steady_clock::now() };
+    Allocations = 0;
+    Counting    = true;
+
+    for (size_t i = 0; i < FrameCount * CountedLoops; ++i)
+        advance();
+
+    Counting = false;
+    ms_per_frame = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                             start)
+                       .count() /
+                   (FrameCount * CountedLoops);
+
+    // Every shown frame emits signal_pixbuf_changed, nothing is connected to it
+    image.reset_gif_animation();
+    while (Glib::MainContext::get_default()->iteration(false))
+        ;
+
+    return Allocations;
+}
+
+int main()
+{
+    Gio::init();
+    // Lets pixbufs returned by gdk-pixbuf be wrapped without initializing GTK
+    Gdk::wrap_init();
+
+    std::string path;
+    g_close(Glib::file_open_tmp(path, "ahoviewer-bench-XXXXXX.gif"), nullptr);
+
+    const std::vector<uint8_t> gif{ create_gif() };
+    Glib::file_set_contents(path, reinterpret_cast<const char*>(gif.data()), gif.size());
+
+    double ms;
+    const size_t frames{ FrameCount * CountedLoops };
+    const size_t unscaled{ play(path, 0, 0, ms) };
+    std::printf("%dx%d frames:  %zu allocations in %zu frames, %.3f ms per frame\n",
+                Width,
+                Height,
+                unscaled,
+                frames,
+                ms);
+
+    const size_t scaled{ play(path, Width * 2 / 3, Height * 2 / 3, ms) };
+    std::printf("Scaled to %dx%d: %zu allocations in %zu frames, %.3f ms per frame\n",
+                Width * 2 / 3,
+                Height * 2 / 3,
+                scaled,
+                frames,
+                ms);
+
+    g_remove(path.c_str());
+
+    return unscaled == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
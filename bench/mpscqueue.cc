@@ -0,0 +1,147 @@
+// Times producers pushing into one queue while a single consumer empties it, MPSCQueue
+// against the mutex guarded TSQueue it replaced (which the consumer popped one element at a
+// time).  Each element is the producer's index and a sequence number, so the consumer can
+// check that every producer's elements arrive in order
+#include "mpscqueue.h"
+using namespace AhoViewer;
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+static constexpr size_t PushesPerProducer{ 200000 }, Runs{ 3 };
+
+template<typename T>
+class TSQueue
+{
+public:
+    void push(T&& v)
+    {
+        std::scoped_lock lock{ m_Mutex };
+        m_Queue.push(std::move(v));
+    }
+    bool pop(T& v)
+    {
+        std::scoped_lock lock{ m_Mutex };
+        if (m_Queue.empty())
+            return false;
+        v = std::move(m_Queue.front());
+        m_Queue.pop();
+        return true;
+    }
+
+private:
+    std::queue<T> m_Queue;
+    std::mutex m_Mutex;
+};
+
+// Returns true if v is the next element of its producer
+static bool check(std::vector<uint32_t>& next, const uint64_t v)
+{
+    const size_t producer{ static_cast<size_t>(v >> 32) };
+    return static_cast<uint32_t>(v) == next[producer]++;
+}
+
+// Runs producers threads that push into queue while consume is called on this thread
+// until it has returned every element.  Returns the time taken in milliseconds, or a
+// negative value if an element arrived out of order
+template<typename Queue, typename Consume>
+static double run(const size_t producers, Consume&& consume)
+{
+    Queue queue;
+    std::atomic<bool> go{ false };
+    std::vector<std::thread> threads;
+    std::vector<uint32_t> next(producers, 0);
+    bool ordered{ true };
+
+    for (size_t p = 0; p < producers; ++p)
+        threads.emplace_back([&queue, &go, p]() {
+            while (!go)
+                std::this_thread::yield();
+
+            for (uint32_t i = 0; i < PushesPerProducer; ++i)
+                queue.push((static_cast<uint64_t>(p) << 32) | i);
+        });
+
+    const auto start{ std::chrono::steady_clock::now() };
+    go = true;
+
+    for (size_t remaining = producers * PushesPerProducer; remaining > 0;)
+    {
+        const size_t n{ consume(queue, next, ordered) };
+        if (n == 0)
+            std::this_thread::yield();
+        remaining -= n;
+    }
+
+    const double ms{
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count()
+    };
+
+    for (auto& t : threads)
+        t.join();
+
+    return ordered ? ms : -1;
+}
+
+// Best of Runs
+template<typename Queue, typename Consume>
+static double best_time(const size_t producers, Consume&& consume)
+{
+    double best{ 0 };
+
+    for (size_t i = 0; i < Runs; ++i)
+    {
+        const double ms{ run<Queue>(producers, consume) };
+        if (ms < 0)
+            return ms;
+        if (i == 0 || ms < best)
+            best = ms;
+    }
+
+    return best;
+}
+
+int main()
+{
+    bool ok{ true };
+
+    std::printf("%zu pushes per producer, %u hardware threads\n",
+                PushesPerProducer,
+                std::thread::hardware_concurrency());
+    std::printf("%10s %14s %14s\n", "producers", "TSQueue", "MPSCQueue");
+
+    for (const size_t producers : { 1, 2, 4, 8 })
+    {
+        const double ts{ best_time<TSQueue<uint64_t>>(
+            producers,
+            [](TSQueue<uint64_t>& q, std::vector<uint32_t>& next, bool& ordered) {
+                size_t n{ 0 };
+                for (uint64_t v; q.pop(v); ++n)
+                    ordered = check(next, v) && ordered;
+                return n;
+            }) };
+        std::vector<uint64_t> drained;
+        const double mpsc{ best_time<MPSCQueue<uint64_t>>(
+            producers,
+            [&drained](MPSCQueue<uint64_t>& q, std::vector<uint32_t>& next, bool& ordered) {
+                drained.clear();
+                const size_t n{ q.drain_into(drained) };
+                for (const uint64_t v : drained)
+                    ordered = check(next, v) && ordered;
+                return n;
+            }) };
+
+        std::printf("%10zu %11.2f ms %11.2f ms\n", producers, ts, mpsc);
+        ok = ok && ts >= 0 && mpsc >= 0;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,134 @@
+// Times sorting generated paths with NaturalSort::sort against std::sort with the comparator
+// it replaced, which parsed both strings again for every comparison
+#include "naturalsort.h"
+using namespace AhoViewer;
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+static constexpr size_t Runs{ 3 };
+
+struct ReparsingNaturalSort
+{
+    bool operator()(const std::string& a, const std::string& b) const
+    {
+        return compare_natural(a.c_str(), b.c_str());
+    }
+
+    static bool compare_natural(const char* a, const char* b)
+    {
+        if (!a || !b)
+            return !!a;
+
+        if (std::isdigit(*a) && std::isdigit(*b))
+        {
+            char *a_after, *b_after;
+            unsigned long a_l = strtoul(a, &a_after, 10), b_l = strtoul(b, &b_after, 10);
+
+            if (a_l != b_l)
+                return a_l < b_l;
+
+            return compare_natural(a_after, b_after);
+        }
+
+        if (std::isdigit(*a) || std::isdigit(*b))
+            return std::isdigit(*a);
+
+        while (*a && *b)
+        {
+            if (std::isdigit(*a) || std::isdigit(*b))
+                return compare_natural(a, b);
+
+            if (std::tolower(*a) != std::tolower(*b))
+                return std::tolower(*a) < std::tolower(*b);
+
+            ++a;
+            ++b;
+        }
+
+        return !!*a;
+    }
+};
+
+// Paths like the ones in a camera or scan folder, with a few different prefixes
+static std::vector<std::string> create_paths(const size_t n)
+{
+    static constexpr const char* Prefixes[]{ "IMG_", "img_", "Scan ", "page", "DSC" };
+    std::mt19937 rng{ 1 };
+    std::uniform_int_distribution<unsigned> number{ 0, 99999 }, copy{ 0, 9 };
+    std::vector<std::string> paths;
+
+    paths.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        std::string path{ "/home/user/Pictures/2024/album " + std::to_string(copy(rng)) + "/" +
+                          Prefixes[i % std::size(Prefixes)] + std::to_string(number(rng)) };
+        if (const unsigned c{ copy(rng) }; c < 3)
+            path += " (" + std::to_string(c + 1) + ")";
+        path += i % 2 ? ".jpg" : ".png";
+
+        paths.push_back(std::move(path));
+    }
+
+    return paths;
+}
+
+// Best of Runs, in milliseconds.  sorted is the result of the last run
+template<typename F>
+static double best_time(const std::vector<std::string>& paths,
+                        std::vector<std::string>& sorted,
+                        F&& f)
+{
+    double best{ 0 };
+
+    for (size_t i = 0; i < Runs; ++i)
+    {
+        sorted = paths;
+
+        const auto start{ std::chrono::steady_clock::now() };
+        f(sorted);
+        const double ms{
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                .count()
+        };
+
+        if (i == 0 || ms < best)
+            best = ms;
+    }
+
+    return best;
+}
+
+int main()
+{
+    bool ok{ true };
+
+    std::printf("%8s %14s %14s %14s\n", "paths", "reparsing", "key per cmp", "sort");
+
+    for (const size_t n : { 1000, 10000, 100000 })
+    {
+        const std::vector<std::string> paths{ create_paths(n) };
+        std::vector<std::string> sorted;
+
+        const double reparsing{ best_time(paths, sorted, [](std::vector<std::string>& v) {
+            std::sort(v.begin(), v.end(), ReparsingNaturalSort{});
+        }) },
+            key_per_cmp{ best_time(paths, sorted, [](std::vector<std::string>& v) {
+                std::sort(v.begin(), v.end(), NaturalSort{});
+            }) },
+            keys{ best_time(paths, sorted, [](std::vector<std::string>& v) {
+                NaturalSort::sort(v);
+            }) };
+
+        std::printf("%8zu %11.2f ms %11.2f ms %11.2f ms\n", n, reparsing, key_per_cmp, keys);
+
+        // Paths that only differ in case are equal, so only the order is checked
+        ok = ok && std::is_sorted(sorted.begin(), sorted.end(), ReparsingNaturalSort{});
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,127 @@
+// Times Resampler::scale against Gdk::Pixbuf::scale_simple for thumbnail, display and
+// upscaling sizes.  Bilinear is compared with INTERP_BILINEAR and Lanczos with INTERP_HYPER,
+// which is what Resampler falls back to for pixbufs it can't scale.  The source is a set of
+// linear ramps, which both should reproduce almost exactly, so the results are also checked
+// against each other
+#include "resample.h"
+using namespace AhoViewer;
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <gdkmm/wrap_init.h>
+#include <string>
+
+static constexpr size_t Runs{ 3 };
+// Mean difference per channel that is still considered the same image
+static constexpr double MaxMeanDifference{ 2.0 };
+
+static Glib::RefPtr<Gdk::Pixbuf> create_ramps(const int w, const int h)
+{
+    auto pixbuf{ Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, w, h) };
+
+    for (int y = 0; y < h; ++y)
+    {
+        guint8* row{ pixbuf->get_pixels() + y * pixbuf->get_rowstride() };
+        for (int x = 0; x < w; ++x)
+        {
+            row[x * 3]     = std::lround(x * 255.0 / (w - 1));
+            row[x * 3 + 1] = std::lround(y * 255.0 / (h - 1));
+            row[x * 3 + 2] = (row[x * 3] + row[x * 3 + 1]) / 2;
+        }
+    }
+
+    return pixbuf;
+}
+
+static double mean_difference(const Glib::RefPtr<Gdk::Pixbuf>& a,
+                              const Glib::RefPtr<Gdk::Pixbuf>& b)
+{
+    double sum{ 0 };
+
+    for (int y = 0; y < a->get_height(); ++y)
+    {
+        const guint8 *ra{ a->get_pixels() + y * a->get_rowstride() },
+            *rb{ b->get_pixels() + y * b->get_rowstride() };
+        for (int x = 0; x < a->get_width() * 3; ++x)
+            sum += std::abs(ra[x] - rb[x]);
+    }
+
+    return sum / (static_cast<double>(a->get_width()) * a->get_height() * 3);
+}
+
+// Best of Runs, in milliseconds.  out is the result of the last run
+template<typename F>
+static double best_time(Glib::RefPtr<Gdk::Pixbuf>& out, F&& f)
+{
+    double best{ 0 };
+
+    for (size_t i = 0; i < Runs; ++i)
+    {
+        const auto start{ std::chrono::steady_clock::now() };
+        out = f();
+        const double ms{
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                .count()
+        };
+
+        if (i == 0 || ms < best)
+            best = ms;
+    }
+
+    return best;
+}
+
+int main()
+{
+    // Lets pixbufs returned by gdk-pixbuf be wrapped without initializing GTK
+    Gdk::wrap_init();
+
+    struct Case
+    {
+        int src_w, src_h, dest_w, dest_h;
+    };
+    static constexpr Case Cases[]{
+        { 4000, 3000, 100, 75 },    // Thumbnail of a photo
+        { 4000, 3000, 1920, 1440 }, // Photo fit to the window
+        { 800, 600, 533, 400 },     // Small downscale
+        { 1920, 1080, 2560, 1440 }, // Upscale
+    };
+    bool ok{ true };
+
+    std::printf("%-24s %-9s %14s %14s %8s\n", "size", "filter", "scale_simple", "Resampler",
+                "diff");
+
+    for (const Case& c : Cases)
+    {
+        const auto src{ create_ramps(c.src_w, c.src_h) };
+        const std::string size{ std::to_string(c.src_w) + "x" + std::to_string(c.src_h) +
+                                " -> " + std::to_string(c.dest_w) + "x" +
+                                std::to_string(c.dest_h) };
+
+        for (const auto filter : { Resampler::Filter::BILINEAR, Resampler::Filter::LANCZOS })
+        {
+            const Gdk::InterpType interp{ filter == Resampler::Filter::LANCZOS
+                                              ? Gdk::INTERP_HYPER
+                                              : Gdk::INTERP_BILINEAR };
+            Glib::RefPtr<Gdk::Pixbuf> gdk, ours;
+
+            const double gdk_ms{ best_time(
+                gdk, [&]() { return src->scale_simple(c.dest_w, c.dest_h, interp); }) },
+                ms{ best_time(
+                    ours, [&]() { return Resampler::scale(src, c.dest_w, c.dest_h, filter); }) };
+            const double diff{ mean_difference(gdk, ours) };
+
+            std::printf("%-24s %-9s %11.2f ms %11.2f ms %8.3f\n",
+                        size.c_str(),
+                        filter == Resampler::Filter::LANCZOS ? "lanczos" : "bilinear",
+                        gdk_ms,
+                        ms,
+                        diff);
+            ok = ok && diff <= MaxMeanDifference;
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
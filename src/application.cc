@@ -3,6 +3,7 @@ using namespace AhoViewer;
 
 #include "booru/site.h"
 #include "config.h"
+#include "executor.h"
 #include "imagelist.h"
 #include "mainwindow.h"
 #include "preferences.h"
@@ -410,7 +411,7 @@ void Application::on_shutdown()
 
     std::vector<std::future<void>> futures;
     for (const std::shared_ptr<Booru::Site>& site : Settings.get_sites())
-        futures.push_back(std::async(std::launch::async, &Booru::Site::save_tags, site));
+        futures.push_back(Executor::get_instance().push([site]() { site->save_tags(); }));
 
 #if _WIN32
     // Clean up gdbus-nonce-file-XXXXXX
@@ -427,4 +428,12 @@ void Application::on_shutdown()
 
     for (auto& f : futures)
         f.get();
+
+#ifndef NDEBUG
+    const auto metrics{ Executor::get_instance().get_metrics() };
+    std::cerr << "Executor: " << metrics.tasks_run << " tasks, "
+              << metrics.average_latency.count() << "us average latency, "
+              << metrics.max_latency.count() << "us max latency, "
+              << metrics.idle_time.count() / 1000 << "ms idle" << std::endl;
+#endif // !NDEBUG
 }
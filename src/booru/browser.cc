@@ -591,9 +591,14 @@ void Browser::on_switch_page(Gtk::Widget* w, guint)
     // Save the tagview scroll pos from the previously selected page so it can be restored when
     // switching back
     if (m_CurrentPage)
+    {
         m_CurrentPage->m_TagViewPos = m_TagView->get_scroll_position();
+        // Hidden pages keep loading their thumbnails, but only once nothing else needs to run
+        m_CurrentPage->get_imagelist()->set_thumbnail_priority(Executor::Priority::BACKGROUND);
+    }
 
     m_CurrentPage = page;
+    page->get_imagelist()->set_thumbnail_priority(Executor::Priority::THUMBNAIL);
 
     if (!page->get_imagelist()->empty())
         bimage = std::static_pointer_cast<Image>(page->get_imagelist()->get_current());
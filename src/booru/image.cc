@@ -1,6 +1,7 @@
 #include "image.h"
 using namespace AhoViewer::Booru;
 
+#include "resample.h"
 #include "settings.h"
 #include "site.h"
 
@@ -114,8 +115,10 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_thumbnail(Glib::RefPtr<Gio::Cancella
                     Gdk::Pixbuf::create_subpixbuf(m_UnscaledThumbnailPixbuf, x, y, m, m);
 
                 if (m != BooruThumbnailSize)
-                    m_ThumbnailPixbuf = m_ThumbnailPixbuf->scale_simple(
-                        BooruThumbnailSize, BooruThumbnailSize, Gdk::INTERP_BILINEAR);
+                    m_ThumbnailPixbuf = Resampler::scale(m_ThumbnailPixbuf,
+                                                         BooruThumbnailSize,
+                                                         BooruThumbnailSize,
+                                                         Resampler::Filter::LANCZOS);
             }
         }
         else if (!m_ThumbnailCurler.is_cancelled())
@@ -294,8 +297,9 @@ void Image::on_finished()
             if (AhoViewer::Image::load_gif(anim, len, data))
             {
                 std::scoped_lock lock{ m_Mutex };
-                m_GIFanim = anim;
-                m_GIFdata = data;
+                m_GIFanim     = anim;
+                m_GIFdata     = data;
+                m_GIFdataSize = len;
                 create_gif_frame_pixbuf();
             }
             else
@@ -131,8 +131,10 @@ void ImageFetcher::unpause_handle(Curler* curler)
 
 void ImageFetcher::on_handle_added()
 {
-    Curler* curler{ nullptr };
-    while (!m_Shutdown && m_CurlerQueue.pop(curler))
+    if (m_Shutdown)
+        return;
+
+    for (Curler* curler : m_CurlerQueue.pop_all())
     {
         m_Curlers.push_back(curler);
         curler->set_imagefetcher(this);
@@ -144,8 +146,10 @@ void ImageFetcher::on_handle_added()
 
 void ImageFetcher::on_handle_unpause()
 {
-    Curler* curler{ nullptr };
-    while (!m_Shutdown && m_CurlerUnpauseQueue.pop(curler))
+    if (m_Shutdown)
+        return;
+
+    for (Curler* curler : m_CurlerUnpauseQueue.pop_all())
     {
         curler->m_Pause = false;
         curl_easy_pause(curler->m_EasyHandle, CURLPAUSE_CONT);
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "curler.h"
-#include "tsqueue.h"
+#include "mpscqueue.h"
 
 #include <thread>
 
@@ -48,7 +48,7 @@ namespace AhoViewer::Booru
 
         CURLM* m_MultiHandle;
         int m_RunningHandles{ 0 };
-        TSQueue<Curler*> m_CurlerQueue, m_CurlerUnpauseQueue;
+        MPSCQueue<Curler*> m_CurlerQueue, m_CurlerUnpauseQueue;
         std::vector<Curler*> m_Curlers;
 
         std::weak_ptr<Glib::Dispatcher> m_SignalHandleAdded, m_SignalHandleUnpause;
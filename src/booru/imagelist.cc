@@ -88,6 +88,7 @@ void ImageList::load(const std::vector<PostDataTuple>& posts, const size_t posts
             get_path(),
             Glib::uri_unescape_string(Glib::path_get_basename(junk_trimmed_image_url))) };
 
+        std::scoped_lock lock{ m_ThumbnailMutex };
         m_Images.push_back(std::make_shared<Image>(image_path,
                                                    image_url,
                                                    thumb_path,
@@ -104,11 +105,7 @@ void ImageList::load(const std::vector<PostDataTuple>& posts, const size_t posts
         return;
 
     m_Widget->reserve(m_Images.size() - old_size);
-
-    if (m_ThumbnailThread.joinable())
-        m_ThumbnailThread.join();
-
-    m_ThumbnailThread = std::thread(sigc::mem_fun(*this, &ImageList::load_thumbnails));
+    load_thumbnails();
 
     // Select the first image on initial load
     if (page->get_page_num() == 1)
@@ -127,6 +124,7 @@ void ImageList::set_current(const size_t index, const bool from_widget, const bo
     if (index == m_Index && !force)
         return;
 
+    update_nav_direction(index);
     m_Index = index;
     m_SignalChanged(m_Images[m_Index]);
     update_cache();
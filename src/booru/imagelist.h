@@ -23,7 +23,7 @@ namespace AhoViewer::Booru
 
         void clear() override;
         void load(const std::vector<PostDataTuple>& posts, const size_t posts_count = 0);
-        bool is_loading() const { return m_ThreadPool.active(); }
+        bool is_loading() const { return m_ThumbnailGroup.active(); }
 
     protected:
         void set_current(const size_t index,
@@ -2,10 +2,10 @@
 using namespace AhoViewer::Booru;
 
 #include "curler.h"
+#include "executor.h"
 #include "image.h"
 #include "settings.h"
 #include "site.h"
-#include "threadpool.h"
 
 #include <glibmm/i18n.h>
 #include <iostream>
@@ -67,6 +67,9 @@ Page::Page()
 
     m_ScrollConn = get_vadjustment()->signal_value_changed().connect(
         sigc::mem_fun(*this, &Page::on_value_changed));
+    get_vadjustment()->signal_value_changed().connect(
+        [&]() { m_SignalVisibleRangeChanged(); });
+    get_vadjustment()->signal_changed().connect([&]() { m_SignalVisibleRangeChanged(); });
 
     m_IconView->set_column_spacing(0);
     m_IconView->set_row_spacing(0);
@@ -111,18 +114,46 @@ Page::~Page()
     m_ListStore->clear();
 }
 
-void Page::set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
+bool Page::get_visible_range(size_t& start, size_t& end) const
 {
+    Gtk::TreePath start_path, end_path;
+
+    if (!m_IconView->get_visible_range(start_path, end_path))
+        return false;
+
+    start = start_path[0];
+    end   = end_path[0];
+
+    return true;
+}
+
+void Page::set_pixbufs(const std::vector<ImageList::PixbufPair>& pixbufs)
+{
+    // The icon view lays out the new pixbufs after this returns, which can change the
+    // adjustment's value.  Scroll events are ignored until that has happened
     m_ScrollConn.block();
-    ImageList::Widget::set_pixbuf(index, pixbuf);
-    while (Glib::MainContext::get_default()->pending())
-        Glib::MainContext::get_default()->iteration(true);
+    ImageList::Widget::set_pixbufs(pixbufs);
+
+    for (const auto& p : pixbufs)
+        m_AlignPending = m_AlignPending || m_ImageList->get_index() >= p.first;
+
+    if (!m_AlignConn)
+        m_AlignConn = Glib::signal_idle().connect(sigc::mem_fun(*this, &Page::on_pixbufs_set),
+                                                  Glib::PRIORITY_LOW);
+}
+
+bool Page::on_pixbufs_set()
+{
     m_ScrollConn.unblock();
 
     // Only keep the thumbnail aligned if the user has not scrolled
-    // and the thumbnail is most likely still being loaded
-    if (m_KeepAligned && m_ImageList->get_index() >= index)
+    // and a thumbnail before it was loaded
+    if (m_KeepAligned && m_AlignPending)
         scroll_to_selected();
+
+    m_AlignPending = false;
+
+    return false;
 }
 
 void Page::set_selected(const size_t index)
@@ -209,10 +240,10 @@ void Page::save_images(const std::string& path)
     m_SaveImagesCurrent = 0;
     m_SaveImagesTotal   = m_ImageList->get_vector_size();
     m_SaveImagesThread  = std::thread([&, path]() {
-        ThreadPool pool;
+        TaskGroup group{ Executor::Priority::BACKGROUND };
         for (const std::shared_ptr<AhoViewer::Image>& img : *m_ImageList)
         {
-            pool.push([&, path, img]() {
+            group.push([&, path, img]() {
                 if (m_SaveCancel->is_cancelled())
                     return;
 
@@ -227,7 +258,7 @@ void Page::save_images(const std::string& path)
         }
 
         m_SignalSaveProgressDisp();
-        pool.wait();
+        group.wait();
         m_Saving = false;
     });
 }
@@ -37,7 +37,8 @@ namespace AhoViewer::Booru
         sigc::signal<void> signal_on_last_page() const { return m_SignalOnLastPage; }
 
     protected:
-        void set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf) override;
+        void set_pixbufs(const std::vector<ImageList::PixbufPair>& pixbufs) override;
+        bool get_visible_range(size_t& start, size_t& end) const override;
         void set_selected(const size_t index) override;
         void scroll_to_selected() override;
 
@@ -110,6 +111,7 @@ namespace AhoViewer::Booru
         void on_posts_downloaded();
         void on_selection_changed();
         void on_value_changed();
+        bool on_pixbufs_set();
         bool on_button_press_event(GdkEventButton* e) override;
         bool on_tab_button_release_event(GdkEventButton* e);
 
@@ -131,14 +133,14 @@ namespace AhoViewer::Booru
         size_t m_Page{ 0 }, m_SaveImagesTotal{ 0 }, m_PostsCount{ 0 };
         std::atomic<size_t> m_SaveImagesCurrent{ 0 };
         std::atomic<bool> m_Saving{ false };
-        bool m_LastPage{ false }, m_KeepAligned{ false };
+        bool m_LastPage{ false }, m_KeepAligned{ false }, m_AlignPending{ false };
         std::vector<PostDataTuple> m_Posts;
 
         Glib::RefPtr<Gio::Cancellable> m_SaveCancel;
         std::thread m_GetPostsThread, m_SaveImagesThread;
         Glib::Dispatcher m_SignalPostsDownloaded, m_SignalSaveProgressDisp;
 
-        sigc::connection m_GetNextPageConn, m_ScrollConn;
+        sigc::connection m_GetNextPageConn, m_ScrollConn, m_AlignConn;
 
         SignalClosedType m_SignalClosed;
         SignalDownloadErrorType m_SignalDownloadError;
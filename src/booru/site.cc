@@ -13,6 +13,7 @@ extern "C"
 {
 #include "entities.h"
 }
+#include "executor.h"
 #include "image.h"
 #include "settings.h"
 
@@ -1124,8 +1125,11 @@ std::unordered_map<std::string, Tag::Type> Site::get_posts_tags(const xml::Docum
         return tags;
     };
 
+    // The caller blocks on these, at the default priority they would wait behind every
+    // queued background task and be limited to half of the workers
     for (const auto& t : split_tags)
-        jobs.push_back(std::async(std::launch::async, tag_task, m_Url, t));
+        jobs.push_back(Executor::get_instance().push(
+            [url = m_Url, t]() { return tag_task(url, t); }, Executor::Priority::INTERACTIVE));
 
     // Wait for all the jobs to finish and combine all the tags
     for (auto& job : jobs)
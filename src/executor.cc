@@ -0,0 +1,431 @@
+#include "executor.h"
+using namespace AhoViewer;
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+// Index of the worker the calling thread is, or max if it's not a worker
+static thread_local size_t WorkerIndex{ std::numeric_limits<size_t>::max() };
+
+Executor::Executor()
+{
+    // Leave one core for the GTK thread, but always have more than one worker so a
+    // blocking download can't stall everything else
+    const size_t n_cores{ std::thread::hardware_concurrency() },
+        n_threads{ std::max<size_t>(n_cores > 1 ? n_cores - 1 : 1, 2) };
+
+    m_Limits = { n_threads,
+                 std::max<size_t>(n_threads - 1, 1),
+                 std::max<size_t>(n_threads / 2, 1) };
+
+    for (size_t p = 0; p < PriorityCount; ++p)
+    {
+        m_Queued[p]  = 0;
+        m_Running[p] = 0;
+    }
+
+    for (size_t i = 0; i < n_threads; ++i)
+        m_Workers.push_back(std::make_unique<Worker>());
+
+    // Start the threads once every worker exists since they steal from each other
+    for (size_t i = 0; i < n_threads; ++i)
+        m_Workers[i]->thread = std::thread(&Executor::worker_thread, this, i);
+}
+
+// Queued tasks are dropped, anything that still needs to finish (e.g. saving tags) waits
+// for its futures or group before the application exits
+Executor::~Executor()
+{
+    {
+        std::scoped_lock lock{ m_Mutex };
+        m_Stop = true;
+    }
+    m_Cond.notify_all();
+
+    for (auto& w : m_Workers)
+        w->thread.join();
+}
+
+void Executor::push_task(Task&& task, const Priority priority)
+{
+    const auto p{ static_cast<size_t>(priority) };
+
+    task.pushed = Clock::now();
+
+    // Counted first so a worker never takes a task that isn't counted yet
+    ++m_Queued[p];
+
+    if (is_worker())
+    {
+        {
+            Worker& w{ *m_Workers[WorkerIndex] };
+            std::scoped_lock lock{ w.mutex };
+            w.queues[p].push_back(std::move(task));
+        }
+
+        // Workers check for tasks with m_Mutex locked before waiting
+        std::scoped_lock lock{ m_Mutex };
+    }
+    else
+    {
+        std::scoped_lock lock{ m_Mutex };
+        m_Queues[p].push_back(std::move(task));
+    }
+
+    m_Cond.notify_one();
+}
+
+// Reserves a running slot for priority if it is under its limit
+bool Executor::reserve(const size_t priority)
+{
+    size_t running{ m_Running[priority] };
+
+    while (running < m_Limits[priority])
+        if (m_Running[priority].compare_exchange_weak(running, running + 1))
+            return true;
+
+    return false;
+}
+
+// Takes the highest priority task that can run.  Workers take the newest task from
+// their own queues, then the oldest shared task, then steal the oldest task of another worker
+bool Executor::take_task(Task& task, size_t& priority)
+{
+    const bool worker{ is_worker() };
+
+    for (size_t p = 0; p < PriorityCount; ++p)
+    {
+        if (m_Queued[p] == 0 || !reserve(p))
+            continue;
+
+        bool found{ false };
+
+        if (worker)
+        {
+            Worker& w{ *m_Workers[WorkerIndex] };
+            std::scoped_lock lock{ w.mutex };
+
+            if (!w.queues[p].empty())
+            {
+                task = std::move(w.queues[p].back());
+                w.queues[p].pop_back();
+                found = true;
+            }
+        }
+
+        if (!found)
+        {
+            std::scoped_lock lock{ m_Mutex };
+
+            if (!m_Queues[p].empty())
+            {
+                task = std::move(m_Queues[p].front());
+                m_Queues[p].pop_front();
+                found = true;
+            }
+        }
+
+        const size_t start{ worker ? WorkerIndex + 1 : 0 };
+        for (size_t i = 0; !found && i < m_Workers.size(); ++i)
+        {
+            Worker& w{ *m_Workers[(start + i) % m_Workers.size()] };
+            std::scoped_lock lock{ w.mutex };
+
+            if (!w.queues[p].empty())
+            {
+                task = std::move(w.queues[p].front());
+                w.queues[p].pop_front();
+                found = true;
+            }
+        }
+
+        if (found)
+        {
+            --m_Queued[p];
+            priority = p;
+            record_latency(task);
+            return true;
+        }
+
+        --m_Running[p];
+    }
+
+    return false;
+}
+
+void Executor::record_latency(const Task& task)
+{
+    const uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 Clock::now() - task.pushed)
+                                 .count();
+    uint64_t max{ m_MaxLatency };
+
+    ++m_TasksRun;
+    m_TotalLatency += latency;
+
+    while (latency > max && !m_MaxLatency.compare_exchange_weak(max, latency))
+        ;
+}
+
+// Whether any queued task is under its priority's limit, called with m_Mutex locked
+bool Executor::runnable() const
+{
+    for (size_t p = 0; p < PriorityCount; ++p)
+        if (m_Queued[p] > 0 && m_Running[p] < m_Limits[p])
+            return true;
+
+    return false;
+}
+
+void Executor::run_task(Task& task, const size_t priority)
+{
+    if (!task.group || !task.group->m_Cancelling)
+        task.func();
+
+    // Release the captures before the group is told the task is done
+    task.func = nullptr;
+    --m_Running[priority];
+
+    // A task of this priority may have been waiting for the slot
+    if (m_Queued[priority] > 0)
+    {
+        {
+            std::scoped_lock lock{ m_Mutex };
+        }
+        m_Cond.notify_one();
+    }
+
+    if (task.group)
+        task.group->finish();
+}
+
+bool Executor::run_one()
+{
+    Task task;
+    size_t priority;
+
+    if (!take_task(task, priority))
+        return false;
+
+    run_task(task, priority);
+    return true;
+}
+
+bool Executor::run_group_task(const TaskGroup* group)
+{
+    Task task;
+    size_t priority{ 0 };
+    bool found{ false };
+    auto take{ [&](std::deque<Task>& queue, const size_t p, const bool newest) {
+        auto match{ [group](const Task& t) { return t.group == group; } };
+        auto it{ queue.end() };
+
+        if (!newest)
+            it = std::find_if(queue.begin(), queue.end(), match);
+        else if (auto r{ std::find_if(queue.rbegin(), queue.rend(), match) }; r != queue.rend())
+            it = std::prev(r.base());
+
+        if (it == queue.end())
+            return;
+
+        task = std::move(*it);
+        queue.erase(it);
+        priority = p;
+        found    = true;
+    } };
+
+    for (size_t p = 0; !found && p < PriorityCount; ++p)
+    {
+        if (m_Queued[p] == 0)
+            continue;
+
+        {
+            Worker& w{ *m_Workers[WorkerIndex] };
+            std::scoped_lock lock{ w.mutex };
+            take(w.queues[p], p, true);
+        }
+
+        if (!found)
+        {
+            std::scoped_lock lock{ m_Mutex };
+            take(m_Queues[p], p, false);
+        }
+
+        for (size_t i = 1; !found && i < m_Workers.size(); ++i)
+        {
+            Worker& w{ *m_Workers[(WorkerIndex + i) % m_Workers.size()] };
+            std::scoped_lock lock{ w.mutex };
+            take(w.queues[p], p, false);
+        }
+    }
+
+    if (!found)
+        return false;
+
+    // Counted as running before it stops being queued, like take_task
+    ++m_Running[priority];
+    --m_Queued[priority];
+    record_latency(task);
+    run_task(task, priority);
+
+    return true;
+}
+
+size_t Executor::remove_tasks(const TaskGroup* group)
+{
+    size_t removed{ 0 };
+    auto remove{ [&](std::deque<Task>& queue, const size_t p) {
+        auto it{ std::remove_if(
+            queue.begin(), queue.end(), [group](const Task& t) { return t.group == group; }) };
+        const auto n{ static_cast<size_t>(queue.end() - it) };
+
+        queue.erase(it, queue.end());
+        m_Queued[p] -= n;
+        removed += n;
+    } };
+
+    {
+        std::scoped_lock lock{ m_Mutex };
+        for (size_t p = 0; p < PriorityCount; ++p)
+            remove(m_Queues[p], p);
+    }
+
+    for (auto& w : m_Workers)
+    {
+        std::scoped_lock lock{ w->mutex };
+        for (size_t p = 0; p < PriorityCount; ++p)
+            remove(w->queues[p], p);
+    }
+
+    return removed;
+}
+
+void Executor::move_tasks(const TaskGroup* group, const size_t priority)
+{
+    auto move{ [&](std::array<std::deque<Task>, PriorityCount>& queues) {
+        for (size_t p = 0; p < PriorityCount; ++p)
+        {
+            if (p == priority)
+                continue;
+
+            auto it{ std::stable_partition(queues[p].begin(),
+                                           queues[p].end(),
+                                           [group](const Task& t) { return t.group != group; }) };
+            const auto n{ static_cast<size_t>(queues[p].end() - it) };
+
+            // Counted before they are moved so they are never taken uncounted
+            m_Queued[priority] += n;
+            std::move(it, queues[p].end(), std::back_inserter(queues[priority]));
+            queues[p].erase(it, queues[p].end());
+            m_Queued[p] -= n;
+        }
+    } };
+
+    {
+        std::scoped_lock lock{ m_Mutex };
+        move(m_Queues);
+    }
+
+    for (auto& w : m_Workers)
+    {
+        std::scoped_lock lock{ w->mutex };
+        move(w->queues);
+    }
+
+    // The new priority may be able to run where the old one was at its limit
+    m_Cond.notify_all();
+}
+
+Executor::Metrics Executor::get_metrics() const
+{
+    Metrics m;
+    const uint64_t n{ m_TasksRun };
+
+    for (size_t p = 0; p < PriorityCount; ++p)
+        m.queued[p] = m_Queued[p];
+
+    m.tasks_run       = n;
+    m.average_latency = std::chrono::microseconds(n ? m_TotalLatency / n : 0);
+    m.max_latency     = std::chrono::microseconds(m_MaxLatency);
+    m.idle_time       = std::chrono::microseconds(m_IdleTime);
+
+    return m;
+}
+
+void Executor::worker_thread(const size_t index)
+{
+    WorkerIndex = index;
+
+    while (true)
+    {
+        if (run_one())
+            continue;
+
+        const auto start{ Clock::now() };
+        std::unique_lock<std::mutex> lock{ m_Mutex };
+        m_Cond.wait(lock, [&]() { return m_Stop || runnable(); });
+
+        m_IdleTime +=
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+        if (m_Stop)
+            break;
+    }
+}
+
+bool Executor::is_worker()
+{
+    return WorkerIndex != std::numeric_limits<size_t>::max();
+}
+
+void TaskGroup::cancel()
+{
+    m_Cancelling = true;
+
+    if (const size_t n{ Executor::get_instance().remove_tasks(this) }; n > 0)
+        finish(n);
+
+    // Tasks that were taken before they could be removed are skipped by the executor
+    wait();
+    m_Cancelling = false;
+}
+
+void TaskGroup::set_priority(const Executor::Priority priority)
+{
+    if (m_Priority.exchange(priority) != priority)
+        Executor::get_instance().move_tasks(this, static_cast<size_t>(priority));
+}
+
+void TaskGroup::wait()
+{
+    if (Executor::is_worker())
+    {
+        auto& executor{ Executor::get_instance() };
+
+        // Running unrelated tasks here could keep the caller waiting on e.g. a long cache
+        // or thumbnail loop.  Once none of the group's tasks are queued it only waits for
+        // the running ones, but its running tasks can still push more
+        while (m_Pending > 0)
+        {
+            if (executor.run_group_task(this))
+                continue;
+
+            std::unique_lock<std::mutex> lock{ m_Mutex };
+            m_Cond.wait_for(lock, std::chrono::milliseconds(1), [&]() { return m_Pending == 0; });
+        }
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock{ m_Mutex };
+        m_Cond.wait(lock, [&]() { return m_Pending == 0; });
+    }
+}
+
+void TaskGroup::finish(const size_t n)
+{
+    std::scoped_lock lock{ m_Mutex };
+
+    if ((m_Pending -= n) == 0)
+        m_Cond.notify_all();
+}
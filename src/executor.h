@@ -0,0 +1,191 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace AhoViewer
+{
+    class TaskGroup;
+
+    // A single process wide pool of worker threads that every image list, booru page and
+    // site shares, so opening more of them doesn't create more threads than there are cores.
+    //
+    // Each worker has its own queues that tasks pushed from inside of a task go to, it takes
+    // its newest task first and steals the oldest tasks of the other workers when it runs
+    // out.  Tasks pushed from any other thread are shared by all workers.  Higher priority
+    // tasks are always taken first, and the number of workers running THUMBNAIL and
+    // BACKGROUND tasks is limited since those often block on disk or network I/O
+    class Executor
+    {
+        friend class TaskGroup;
+
+    public:
+        enum class Priority
+        {
+            // Decoding the images the user is looking at or about to look at
+            INTERACTIVE,
+            THUMBNAIL,
+            // Saving images, downloading tags and anything else the user isn't waiting on
+            BACKGROUND,
+        };
+        static constexpr size_t PriorityCount{ 3 };
+
+        struct Metrics
+        {
+            // Tasks waiting to be taken by a worker for each priority
+            std::array<size_t, PriorityCount> queued;
+            size_t tasks_run;
+            // Time between a task being pushed and a worker taking it
+            std::chrono::microseconds average_latency, max_latency;
+            // Total time all workers have spent waiting for tasks
+            std::chrono::microseconds idle_time;
+        };
+
+        static Executor& get_instance()
+        {
+            static Executor i;
+            return i;
+        }
+
+        // Runs f on one of the workers, the returned future can be ignored.  Tasks that
+        // should be cancelled together are pushed through a TaskGroup instead
+        template<typename F>
+        auto push(F&& f, const Priority priority = Priority::BACKGROUND);
+
+        // Number of worker threads
+        size_t size() const { return m_Workers.size(); }
+        Metrics get_metrics() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Task
+        {
+            std::function<void()> func;
+            TaskGroup* group;
+            Clock::time_point pushed;
+        };
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::array<std::deque<Task>, PriorityCount> queues;
+            std::thread thread;
+        };
+
+        Executor();
+        ~Executor();
+        Executor(const Executor&) = delete;
+        Executor& operator=(const Executor&) = delete;
+
+        void push_task(Task&& task, const Priority priority);
+        bool take_task(Task& task, size_t& priority);
+        void record_latency(const Task& task);
+        bool reserve(const size_t priority);
+        bool runnable() const;
+        void run_task(Task& task, const size_t priority);
+        // Takes and runs one task, returns false if none could be taken
+        bool run_one();
+        // Runs one of group's queued tasks on the calling worker, used while a worker waits
+        // for a group.  The waiting worker already holds a running slot, so this doesn't
+        // check the priority's limit
+        bool run_group_task(const TaskGroup* group);
+        // Drops every queued task of group, returns how many were dropped
+        size_t remove_tasks(const TaskGroup* group);
+        // Moves the queued tasks of group to priority
+        void move_tasks(const TaskGroup* group, const size_t priority);
+        void worker_thread(const size_t index);
+        static bool is_worker();
+
+        std::vector<std::unique_ptr<Worker>> m_Workers;
+
+        // Tasks pushed from threads that are not workers, guarded by m_Mutex
+        std::array<std::deque<Task>, PriorityCount> m_Queues;
+        std::array<std::atomic<size_t>, PriorityCount> m_Queued, m_Running;
+        std::array<size_t, PriorityCount> m_Limits;
+        bool m_Stop{ false };
+
+        // Latencies and idle time are in microseconds
+        std::atomic<uint64_t> m_TasksRun{ 0 }, m_TotalLatency{ 0 }, m_MaxLatency{ 0 },
+            m_IdleTime{ 0 };
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Cond;
+    };
+
+    // Tracks the tasks an object pushes to the executor so they can be waited for or
+    // cancelled together.  The group must outlive its tasks, the destructor cancels them
+    class TaskGroup
+    {
+        friend class Executor;
+
+    public:
+        TaskGroup(const Executor::Priority priority = Executor::Priority::BACKGROUND)
+            : m_Priority{ priority }
+        {
+        }
+        ~TaskGroup() { cancel(); }
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        // Runs f on one of the workers.  There is no future since a task that is dropped
+        // by cancel never runs, anything f produces has to be stored by f itself
+        template<typename F>
+        void push(F&& f)
+        {
+            add();
+            Executor::get_instance().push_task({ std::forward<F>(f), this, {} },
+                                               m_Priority.load());
+        }
+
+        // Changes the priority of new tasks and the ones that are still queued, e.g. the
+        // thumbnails of a booru page that is no longer visible
+        void set_priority(const Executor::Priority priority);
+        Executor::Priority get_priority() const { return m_Priority; }
+
+        // Drops the tasks that haven't started and waits for the running ones to finish.
+        // This must not be called from one of the group's own tasks
+        void cancel();
+        // Waits for every task to finish, workers run the group's queued tasks while they
+        // wait instead of blocking
+        void wait();
+
+        // Whether any tasks are queued or running
+        bool active() const { return m_Pending > 0; }
+
+    private:
+        void add() { ++m_Pending; }
+        void finish(const size_t n = 1);
+
+        std::atomic<Executor::Priority> m_Priority;
+        std::atomic<size_t> m_Pending{ 0 };
+        std::atomic<bool> m_Cancelling{ false };
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Cond;
+    };
+
+    template<typename F>
+    auto Executor::push(F&& f, const Priority priority)
+    {
+        using return_type = std::invoke_result_t<std::decay_t<F>>;
+
+        auto task{ std::make_shared<std::packaged_task<return_type()>>(std::forward<F>(f)) };
+        auto future{ task->get_future() };
+
+        push_task({ [task]() { (*task)(); }, nullptr, {} }, priority);
+
+        return future;
+    }
+}
@@ -1,53 +1,78 @@
 #include "image.h"
 using namespace AhoViewer;
 
+#include "executor.h"
+#include "resample.h"
 #include "settings.h"
 #include "util.h"
 
+#ifdef HAVE_LIBJPEG
+#include "jpegthumbnailer.h"
+#endif // HAVE_LIBJPEG
+
+#include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <giomm.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gtkmm.h>
 #include <iostream>
+#include <unordered_set>
+#include <utility>
 
 const std::string Image::NormalThumbnailDir =
     Glib::build_filename(Glib::get_user_cache_dir(), "thumbnails", "normal");
 const std::string Image::LargeThumbnailDir =
     Glib::build_filename(Glib::get_user_cache_dir(), "thumbnails", "large");
 
+// data is the contents of mapped when it is set, otherwise a g_malloc'd copy
+static void free_gif(nsgif_t* anim, unsigned char* data, GMappedFile* mapped)
+{
+    nsgif_destroy(anim);
+
+    if (mapped)
+        g_mapped_file_unref(mapped);
+    else
+        g_free(data);
+}
+
 bool Image::is_valid(const std::string& path)
 {
     return gdk_pixbuf_get_file_info(path.c_str(), nullptr, nullptr) != nullptr || is_webm(path);
 }
 
-bool Image::is_valid_extension(const std::string& path)
+// The extensions of every format gdk-pixbuf can load, gathered once since
+// Gdk::Pixbuf::get_formats allocates every format's extension list
+static std::unordered_set<std::string> get_supported_extensions()
 {
-    std::string ext{ path.substr(path.find_last_of('.') + 1) };
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    std::unordered_set<std::string> extensions;
+
+    for (Gdk::PixbufFormat i : Gdk::Pixbuf::get_formats())
+    {
+        gchar** exts = gdk_pixbuf_format_get_extensions(i.gobj());
+        for (int j = 0; exts[j] != nullptr; ++j)
+            extensions.emplace(exts[j]);
+
+        g_strfreev(exts);
+    }
 
 #ifdef HAVE_GSTREAMER
-    if (ext == "webm" || ext == "mp4")
-        return true;
+    extensions.emplace("webm");
+    extensions.emplace("mp4");
 #endif // HAVE_GSTREAMER
 
-    bool r = false;
-
-    for (Gdk::PixbufFormat i : Gdk::Pixbuf::get_formats())
-    {
-        gchar** extensions = gdk_pixbuf_format_get_extensions(i.gobj());
-        for (int j = 0; extensions[j] != nullptr; ++j)
-        {
-            if (strcmp(ext.c_str(), extensions[j]) == 0)
-                r = true;
-        }
+    return extensions;
+}
 
-        g_strfreev(extensions);
+bool Image::is_valid_extension(const std::string& path)
+{
+    static const std::unordered_set<std::string> extensions{ get_supported_extensions() };
 
-        if (r)
-            break;
-    }
+    std::string ext{ path.substr(path.find_last_of('.') + 1) };
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 
-    return r;
+    return extensions.find(ext) != extensions.end();
 }
 
 bool Image::is_webm([[maybe_unused]] const std::string& path)
@@ -71,17 +96,60 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_missing_pixbuf()
     return pixbuf;
 }
 
+// nsgif frame bitmaps are kept in a pool when their GIF is freed so that the next GIF
+// with the same size can reuse them.  The size of each bitmap is stored in front of it
+static constexpr size_t BitmapHeaderSize{ 16 }, MaxPooledBitmapBytes{ 64 * 1024 * 1024 };
+static std::mutex BitmapPoolMutex;
+static std::vector<uint8_t*> BitmapPool;
+static size_t BitmapPoolBytes{ 0 };
+
+static size_t bitmap_size(uint8_t* block)
+{
+    return *reinterpret_cast<size_t*>(block);
+}
+
 static nsgif_bitmap_t* _def_bitmap_create(int width, int height)
 {
-    return new uint8_t[width * height * 4];
+    const size_t size{ static_cast<size_t>(width) * height * 4 };
+    {
+        std::scoped_lock lock{ BitmapPoolMutex };
+        auto it{ std::find_if(BitmapPool.begin(), BitmapPool.end(), [size](uint8_t* b) {
+            return bitmap_size(b) == size;
+        }) };
+
+        if (it != BitmapPool.end())
+        {
+            uint8_t* block{ *it };
+            BitmapPool.erase(it);
+            BitmapPoolBytes -= size;
+
+            return block + BitmapHeaderSize;
+        }
+    }
+
+    auto block{ new uint8_t[size + BitmapHeaderSize] };
+    *reinterpret_cast<size_t*>(block) = size;
+
+    return block + BitmapHeaderSize;
 }
 
 static void _def_bitmap_destroy(nsgif_bitmap_t* bitmap)
 {
-    if (bitmap)
+    if (!bitmap)
+        return;
+
+    uint8_t* block{ static_cast<uint8_t*>(bitmap) - BitmapHeaderSize };
+    const size_t size{ bitmap_size(block) };
+
+    std::scoped_lock lock{ BitmapPoolMutex };
+    if (BitmapPoolBytes + size <= MaxPooledBitmapBytes)
     {
-        delete[] static_cast<uint8_t*>(bitmap);
-        bitmap = nullptr;
+        BitmapPool.push_back(block);
+        BitmapPoolBytes += size;
+    }
+    else
+    {
+        delete[] block;
     }
 }
 
@@ -104,6 +172,8 @@ Image::Image(std::string path) : m_IsWebM{ Image::is_webm(path) }, m_Path{ std::
 Image::~Image()
 {
     reset_pixbuf();
+    // The stopped decoder thread still uses this Image's members
+    wait_gif_decoder();
 }
 
 bool Image::is_animated_gif() const
@@ -129,8 +199,7 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_pixbuf()
     return m_Pixbuf;
 }
 
-// Private method used internally by gif_advance_frame
-// and by load_pixbuf when m_Pixbuf is null
+// Private method used by load_pixbuf to create the first frame's pixbuf
 void Image::create_gif_frame_pixbuf()
 {
     const nsgif_info_t *info = nsgif_get_info(m_GIFanim);
@@ -152,14 +221,17 @@ void Image::create_gif_frame_pixbuf()
 
     if (result == NSGIF_OK)
     {
-        m_Pixbuf =
-            Gdk::Pixbuf::create_from_data(static_cast<unsigned char*>(frame_image),
-                                          Gdk::COLORSPACE_RGB,
-                                          true,
-                                          8,
-                                          info->width,
-                                          info->height,
-                                          (info->width * 4 + 3) & ~3);
+        // nsgif composes every frame into the same bitmap, the decoder thread will
+        // overwrite it so a copy is needed
+        m_Pixbuf = Gdk::Pixbuf::create_from_data(static_cast<unsigned char*>(frame_image),
+                                                 Gdk::COLORSPACE_RGB,
+                                                 true,
+                                                 8,
+                                                 info->width,
+                                                 info->height,
+                                                 (info->width * 4 + 3) & ~3)
+                       ->copy();
+        m_GIFfirstFrame = m_Pixbuf;
         m_SignalPixbufChanged();
     }
     else
@@ -175,6 +247,14 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_thumbnail(Glib::RefPtr<Gio::Cancella
     if (m_ThumbnailPixbuf)
         return m_ThumbnailPixbuf;
 
+    GStatBuf file_info;
+    const std::string filename{ Glib::path_get_basename(m_Path) };
+    const bool use_pack{ m_ThumbnailPack && g_stat(m_Path.c_str(), &file_info) == 0 };
+
+    if (use_pack &&
+        (m_ThumbnailPixbuf = m_ThumbnailPack->get(filename, file_info.st_mtime, file_info.st_size)))
+        return m_ThumbnailPixbuf;
+
 #ifdef __linux__
     std::string thumb_filename{ Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5,
                                                                  Glib::filename_to_uri(m_Path)) +
@@ -212,12 +292,15 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_thumbnail(Glib::RefPtr<Gio::Cancella
     if (!m_ThumbnailPixbuf)
         create_thumbnail(c);
 
+    if (use_pack && m_ThumbnailPixbuf && !c->is_cancelled())
+        m_ThumbnailPack->add(filename, file_info.st_mtime, file_info.st_size, m_ThumbnailPixbuf);
+
     return m_ThumbnailPixbuf;
 }
 
 void Image::load_pixbuf(Glib::RefPtr<Gio::Cancellable> c)
 {
-    if (!m_Pixbuf && !m_IsWebM)
+    if ((!m_Pixbuf || (m_Reduced && m_WantFullSize)) && !m_IsWebM)
     {
         Glib::RefPtr<Gio::File> file{ Gio::File::create_for_path(m_Path) };
 
@@ -229,49 +312,73 @@ void Image::load_pixbuf(Glib::RefPtr<Gio::Cancellable> c)
             nsgif_t* anim;
             nsgif_create(&m_BitmapCallbacks, NSGIF_BITMAP_FMT_R8G8B8A8, &anim);
 
-            char* buffer{ nullptr };
-            try
+            unsigned char* data{ nullptr };
+            gsize len{ 0 };
+
+            // Map the file instead of reading it, nsgif needs the data for as long as the
+            // animation is alive and this way it stays in the (shared) page cache
+            GMappedFile* mapped{ g_mapped_file_new(m_Path.c_str(), FALSE, nullptr) };
+            if (mapped)
+            {
+                data = reinterpret_cast<unsigned char*>(g_mapped_file_get_contents(mapped));
+                len  = g_mapped_file_get_length(mapped);
+            }
+            else
             {
-                gsize len;
-                if (file->load_contents(c, buffer, len))
+                char* buffer{ nullptr };
+                try
                 {
-                    if (!c->is_cancelled())
-                    {
-                        auto data{ reinterpret_cast<unsigned char*>(buffer) };
-                        if (load_gif(anim, len, data) && !c->is_cancelled())
-                        {
-                            std::scoped_lock lock{ m_Mutex };
-                            m_GIFanim = anim;
-                            m_GIFdata = data;
-                            create_gif_frame_pixbuf();
-                        }
-                    }
-
-                    if (c->is_cancelled())
-                    {
-                        g_free(buffer);
-                    }
+                    if (file->load_contents(c, buffer, len))
+                        data = reinterpret_cast<unsigned char*>(buffer);
                 }
-                else
+                catch (...)
                 {
-                    nsgif_destroy(anim);
+                    g_free(buffer);
                 }
             }
-            catch (...)
+
+            if (data && !c->is_cancelled() && load_gif(anim, len, data) && !c->is_cancelled())
             {
-                if (!c->is_cancelled())
+                std::scoped_lock lock{ m_Mutex };
+                m_GIFanim     = anim;
+                m_GIFdata     = data;
+                m_GIFdataSize = len;
+                m_GIFmapped   = mapped;
+                create_gif_frame_pixbuf();
+            }
+            else
+            {
+                if (!data && !c->is_cancelled())
                     std::cerr << "Failed to load pixbuf from file '" << m_Path << "'" << std::endl;
 
-                nsgif_destroy(anim);
-                g_free(buffer);
+                free_gif(anim, data, mapped);
             }
         }
         else
         {
             Glib::RefPtr<Gdk::Pixbuf> p{ nullptr };
+            int full_w{ 0 }, full_h{ 0 }, w{ 0 }, h{ 0 };
+
+            if (!m_WantFullSize)
+            {
+                DisplayArea area;
+                {
+                    std::scoped_lock lock{ m_Mutex };
+                    area = m_DecodeArea;
+                }
+
+                if (area.valid() && gdk_pixbuf_get_file_info(m_Path.c_str(), &full_w, &full_h))
+                {
+                    area.get_scaled_size(full_w, full_h, w, h);
+                    // Only bother when the full image is at least twice the size it's drawn at
+                    if (w * 2 > full_w || h * 2 > full_h)
+                        w = h = 0;
+                }
+            }
+
             try
             {
-                p = Gdk::Pixbuf::create_from_stream(file->read(), c);
+                p = load_incremental(file, w, h, c);
             }
             catch (const Glib::Error& e)
             {
@@ -281,10 +388,27 @@ void Image::load_pixbuf(Glib::RefPtr<Gio::Cancellable> c)
             }
 
             if (!p || c->is_cancelled())
+            {
+                // Don't leave a partially decoded pixbuf behind
+                std::scoped_lock lock{ m_Mutex };
+                if (p && m_Pixbuf == p)
+                {
+                    m_Pixbuf.reset();
+                    m_Reduced = false;
+                }
                 return;
+            }
 
             std::scoped_lock lock{ m_Mutex };
-            m_Pixbuf = p;
+            m_Pixbuf       = p;
+            m_Reduced      = w > 0 && h > 0;
+            m_FullWidth    = full_w;
+            m_FullHeight   = full_h;
+            m_WantFullSize = false;
+            m_ScaledPixbuf.reset();
+            m_ScaledSource = nullptr;
+            m_WantMipmaps  = false;
+            m_Mipmaps.clear();
         }
 
         m_Loading = false;
@@ -292,6 +416,295 @@ void Image::load_pixbuf(Glib::RefPtr<Gio::Cancellable> c)
     }
 }
 
+// Decodes the file in LoadChunkSize pieces so cancelling takes effect within one chunk.
+// Large files are set as m_Pixbuf as soon as the loader has created it so the ImageBox can
+// draw the image as it is decoded, the same way downloading booru images are drawn
+Glib::RefPtr<Gdk::Pixbuf> Image::load_incremental(const Glib::RefPtr<Gio::File>& file,
+                                                  const int w,
+                                                  const int h,
+                                                  Glib::RefPtr<Gio::Cancellable> c)
+{
+    auto loader{ Gdk::PixbufLoader::create() };
+    auto stream{ file->read(c) };
+    const auto total{ static_cast<size_t>(
+        stream->query_info(c, G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size()) };
+    bool progressive{ false };
+    std::chrono::steady_clock::time_point last_draw;
+
+    if (total >= ProgressiveLoadSize)
+    {
+        std::scoped_lock lock{ m_Mutex };
+        // Keep showing the reduced pixbuf while the full size one is loaded
+        progressive = !m_Pixbuf;
+    }
+
+    int full_w{ 0 }, full_h{ 0 };
+    loader->signal_size_prepared().connect([&](int width, int height) {
+        full_w = width;
+        full_h = height;
+
+        // Loaders that support it (jpeg) will decode directly at the smaller size
+        if (w > 0 && h > 0)
+            loader->set_size(w, h);
+    });
+
+    if (progressive)
+    {
+        loader->signal_area_prepared().connect([&]() {
+            {
+                std::scoped_lock lock{ m_Mutex };
+                m_Pixbuf = loader->get_pixbuf();
+                // The ImageBox scales the pixbuf by the image's full size while it's drawn
+                m_Reduced    = w > 0 && h > 0;
+                m_FullWidth  = full_w;
+                m_FullHeight = full_h;
+            }
+            m_SignalPixbufChanged();
+            last_draw = std::chrono::steady_clock::now();
+        });
+        loader->signal_area_updated().connect([&](int, int, int, int) {
+            using namespace std::chrono;
+            // Wait longer between draw requests for larger images
+            auto p{ loader->get_pixbuf() };
+            int ms = std::clamp((p->get_width() + p->get_height()) / 60.f, 100.f, 800.f);
+            if (steady_clock::now() >= last_draw + milliseconds(ms))
+            {
+                m_SignalPixbufChanged();
+                last_draw = steady_clock::now();
+            }
+        });
+
+        m_LoadCurrent = 0;
+        m_LoadTotal   = total;
+    }
+
+    std::vector<guint8> buffer(LoadChunkSize);
+    size_t current{ 0 }, reported{ 0 };
+
+    try
+    {
+        gssize n;
+        while ((n = stream->read(buffer.data(), buffer.size(), c)) > 0)
+        {
+            loader->write(buffer.data(), n);
+            current += n;
+
+            // Report each percent read
+            if (progressive && (current - reported) * 100 >= total)
+            {
+                m_LoadCurrent = reported = current;
+                m_SignalLoadProgress();
+            }
+        }
+
+        loader->close();
+    }
+    catch (...)
+    {
+        try
+        {
+            loader->close();
+        }
+        catch (...)
+        {
+        }
+
+        if (progressive)
+        {
+            std::scoped_lock lock{ m_Mutex };
+            if (m_Pixbuf && m_Pixbuf == loader->get_pixbuf())
+            {
+                m_Pixbuf.reset();
+                m_Reduced = false;
+            }
+        }
+
+        throw;
+    }
+
+    if (progressive && reported != total)
+    {
+        m_LoadCurrent = total;
+        m_SignalLoadProgress();
+    }
+
+    return loader->get_pixbuf();
+}
+
+void Image::set_decode_area(const DisplayArea& area)
+{
+    std::scoped_lock lock{ m_Mutex };
+    m_DecodeArea = area;
+}
+
+bool Image::needs_larger_pixbuf(const DisplayArea& area)
+{
+    if (!m_Reduced)
+        return false;
+
+    std::scoped_lock lock{ m_Mutex };
+    if (!m_Pixbuf)
+        return false;
+
+    int w, h;
+    area.get_scaled_size(m_FullWidth, m_FullHeight, w, h);
+
+    return w > m_Pixbuf->get_width() || h > m_Pixbuf->get_height();
+}
+
+bool Image::request_full_size()
+{
+    if (!m_Reduced || m_WantFullSize)
+        return false;
+
+    m_WantFullSize = true;
+    return true;
+}
+
+void Image::get_original_size(int& w, int& h)
+{
+    std::scoped_lock lock{ m_Mutex };
+    if (m_Reduced)
+    {
+        w = m_FullWidth;
+        h = m_FullHeight;
+    }
+    // GIF frames can be scaled by the decoder thread
+    else if (m_GIFanim)
+    {
+        const nsgif_info_t* info = nsgif_get_info(m_GIFanim);
+        w                        = info->width;
+        h                        = info->height;
+    }
+    else if (m_Pixbuf)
+    {
+        w = m_Pixbuf->get_width();
+        h = m_Pixbuf->get_height();
+    }
+    else
+    {
+        w = h = 0;
+    }
+}
+
+bool Image::request_mipmaps()
+{
+    if (m_IsWebM || m_WantMipmaps)
+        return false;
+
+    std::scoped_lock lock{ m_Mutex };
+    if (m_GIFanim || !m_Mipmaps.empty())
+        return false;
+
+    m_WantMipmaps = true;
+    return true;
+}
+
+void Image::create_mipmaps(Glib::RefPtr<Gio::Cancellable> c)
+{
+    if (!m_WantMipmaps || is_loading())
+        return;
+
+    Glib::RefPtr<Gdk::Pixbuf> source;
+    {
+        std::scoped_lock lock{ m_Mutex };
+        if (m_GIFanim || !m_Pixbuf || !m_Mipmaps.empty())
+            return;
+
+        source = m_Pixbuf;
+    }
+
+    // Each level is scaled from the previous one so this costs about as much as
+    // scaling the full pixbuf once
+    std::vector<Glib::RefPtr<Gdk::Pixbuf>> mipmaps;
+    for (Glib::RefPtr<Gdk::Pixbuf> p{ source };
+         p->get_width() / 2 >= MipmapMinSize && p->get_height() / 2 >= MipmapMinSize;)
+    {
+        if (c->is_cancelled())
+            return;
+
+        p = Resampler::scale(
+            p, p->get_width() / 2, p->get_height() / 2, Resampler::Filter::BILINEAR);
+        mipmaps.push_back(p);
+    }
+
+    {
+        std::scoped_lock lock{ m_Mutex };
+        // The pixbuf could have been reset or replaced while these were created
+        if (m_Pixbuf != source)
+            return;
+
+        m_Mipmaps     = std::move(mipmaps);
+        m_WantMipmaps = false;
+    }
+
+    // Let the imagebox redraw using the mipmaps
+    m_SignalPixbufChanged();
+}
+
+Glib::RefPtr<Gdk::Pixbuf> Image::get_mipmap(const double scale)
+{
+    std::scoped_lock lock{ m_Mutex };
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf{ m_Pixbuf };
+
+    if (pixbuf)
+    {
+        const int w{ static_cast<int>(std::ceil(pixbuf->get_width() * scale)) },
+            h{ static_cast<int>(std::ceil(pixbuf->get_height() * scale)) };
+
+        for (const auto& m : m_Mipmaps)
+        {
+            if (m->get_width() < w || m->get_height() < h)
+                break;
+
+            pixbuf = m;
+        }
+    }
+
+    return pixbuf;
+}
+
+std::vector<Glib::RefPtr<Gdk::Pixbuf>> Image::get_mipmaps()
+{
+    std::scoped_lock lock{ m_Mutex };
+    return m_Mipmaps;
+}
+
+size_t Image::get_memory_size()
+{
+    std::scoped_lock lock{ m_Mutex };
+
+    // GIFs have the nsgif frame bitmap, the first, current and previous frames and the
+    // frames decoded ahead of time or waiting to be reused.  Mapped file data is not
+    // counted, it's part of the page cache
+    if (m_GIFanim)
+    {
+        const nsgif_info_t* info = nsgif_get_info(m_GIFanim);
+        std::scoped_lock gif_lock{ m_GIFmutex };
+        return static_cast<size_t>(info->width) * info->height * 4 *
+                   (4 + m_GIFframesCount + m_GIFslots.size()) +
+               (m_GIFmapped ? 0 : m_GIFdataSize);
+    }
+
+    size_t size{ (m_Pixbuf ? m_Pixbuf->get_byte_length() : 0) +
+                 (m_ScaledPixbuf ? m_ScaledPixbuf->get_byte_length() : 0) };
+
+    for (const auto& m : m_Mipmaps)
+        size += m->get_byte_length();
+
+    return size;
+}
+
+void Image::estimate_memory_size()
+{
+    if (m_EstimatedMemorySize == 0 && !m_IsWebM)
+    {
+        int w, h;
+        if (gdk_pixbuf_get_file_info(m_Path.c_str(), &w, &h))
+            m_EstimatedMemorySize = static_cast<size_t>(w) * h * 4;
+    }
+}
+
 bool Image::load_gif(nsgif_t* anim, size_t data_size, uint8_t* data)
 {
     nsgif_error result;
@@ -310,61 +723,182 @@ bool Image::load_gif(nsgif_t* anim, size_t data_size, uint8_t* data)
     }
 }
 
+Glib::RefPtr<Gdk::Pixbuf> Image::get_scaled_pixbuf(const int w, const int h)
+{
+    if (is_loading())
+        return {};
+
+    std::scoped_lock lock{ m_Mutex };
+    if (m_ScaledPixbuf && m_Pixbuf && m_ScaledSource == m_Pixbuf->gobj() &&
+        m_ScaledPixbuf->get_width() == w && m_ScaledPixbuf->get_height() == h)
+        return m_ScaledPixbuf;
+
+    return {};
+}
+
+void Image::set_scaled_pixbuf(const Glib::RefPtr<Gdk::Pixbuf>& source,
+                              const Glib::RefPtr<Gdk::Pixbuf>& scaled)
+{
+    if (is_loading())
+        return;
+
+    std::scoped_lock lock{ m_Mutex };
+    if (m_GIFanim || !m_Pixbuf || m_Pixbuf != source)
+        return;
+
+    m_ScaledPixbuf = scaled;
+    m_ScaledSource = source->gobj();
+}
+
+void Image::create_scaled_pixbuf(const DisplayArea& area)
+{
+    if (m_IsWebM || is_loading())
+        return;
+
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+    int w, h;
+    {
+        std::scoped_lock lock{ m_Mutex };
+        if (m_GIFanim || !m_Pixbuf)
+            return;
+
+        pixbuf = m_Pixbuf;
+        // Reduced pixbufs are drawn at the size the full image would be
+        if (m_Reduced)
+            area.get_scaled_size(m_FullWidth, m_FullHeight, w, h);
+        else
+            area.get_scaled_size(pixbuf->get_width(), pixbuf->get_height(), w, h);
+
+        // Nothing to do if it's drawn unscaled, in tiles or the copy is already the right size
+        if ((w == pixbuf->get_width() && h == pixbuf->get_height()) || area.use_tiles(w, h) ||
+            (m_ScaledPixbuf && m_ScaledSource == pixbuf->gobj() &&
+             m_ScaledPixbuf->get_width() == w && m_ScaledPixbuf->get_height() == h))
+            return;
+    }
+
+    // Scale without holding the lock so the ImageBox isn't blocked by this
+    Glib::RefPtr<Gdk::Pixbuf> scaled{
+        Resampler::scale(pixbuf, w, h, Resampler::Filter::BILINEAR)
+    };
+
+    std::scoped_lock lock{ m_Mutex };
+    // The pixbuf could have been reset while it was being scaled
+    if (m_Pixbuf == pixbuf)
+    {
+        m_ScaledPixbuf = scaled;
+        m_ScaledSource = pixbuf->gobj();
+    }
+}
+
+void Image::reset_scaled_pixbuf()
+{
+    std::scoped_lock lock{ m_Mutex };
+    m_ScaledPixbuf.reset();
+    m_ScaledSource = nullptr;
+}
+
 void Image::reset_pixbuf()
 {
     m_Loading = true;
+
     std::scoped_lock lock{ m_Mutex };
     m_Pixbuf.reset();
+    m_ScaledPixbuf.reset();
+    m_ScaledSource = nullptr;
+    m_Reduced      = false;
+    m_WantFullSize = false;
+    m_WantMipmaps  = false;
+    m_Mipmaps.clear();
+
+    // The decoder thread uses m_GIFanim, it is freed once the thread has been joined
+    stop_gif_decoder(true);
 
     if (m_GIFanim)
     {
-        nsgif_destroy(m_GIFanim);
-        m_GIFanim = nullptr;
+        free_gif(m_GIFanim, m_GIFdata, m_GIFmapped);
+        m_GIFanim     = nullptr;
+        m_GIFdata     = nullptr;
+        m_GIFmapped   = nullptr;
+        m_GIFdataSize = 0;
+    }
 
-        if (m_GIFdata)
-        {
-            g_free(m_GIFdata);
-            m_GIFdata = nullptr;
-        }
+    m_GIFfirstFrame.reset();
+    m_GIFfinished = false;
+    m_GIFrewind   = false;
+}
 
-        reset_gif_animation();
-    }
+void Image::start_gif_decoder()
+{
+    if (m_GIFthread.joinable() || !is_animated_gif() || m_GIFfinished)
+        return;
+
+    // The previous decoder thread uses the same members
+    wait_gif_decoder();
+
+    m_GIFstop        = false;
+    m_GIFdecoderDone = false;
+    // Enough for every frame pixbuf in use so returning them never allocates
+    m_GIFslots.reserve(GIFMaxFrames + 2);
+    m_GIFthread =
+        std::thread(sigc::bind(sigc::mem_fun(*this, &Image::gif_decoder_thread), m_GIFanim));
 }
 
-bool Image::gif_advance_frame()
+void Image::set_gif_frame_size(const int w, const int h)
 {
-    std::scoped_lock lock{ m_Mutex };
-    const nsgif_info_t *info = nsgif_get_info(m_GIFanim);
+    std::scoped_lock lock{ m_GIFmutex };
+    m_GIFframeWidth  = w;
+    m_GIFframeHeight = h;
+}
 
-    // Handle frame advacing and looping.
-    if (info->frame_count > 1)
+bool Image::gif_advance_frame()
+{
+    GIFFrame frame;
     {
-        // Currently on the last frame, reset to first frame unless we finished
-        // the final loop
-        if (m_GIFcurFrame == info->frame_count - 1 &&
-            m_GIFcurLoop != info->loop_max)
-        {
-            // Only increment the loop counter if it's not looping forever.
-            if (info->loop_max > 0)
-                ++m_GIFcurLoop;
-            m_GIFcurFrame = 0;
-        }
-        else if (m_GIFcurFrame < info->frame_count - 1)
+        std::scoped_lock lock{ m_GIFmutex };
+        if (m_GIFframesCount == 0)
         {
-            ++m_GIFcurFrame;
+            // The decoder stopped without reaching the last frame (decoding error)
+            if (m_GIFdecoderDone)
+            {
+                m_GIFfinished = true;
+                return true;
+            }
+
+            // Only count each frame that is late once
+            if (!m_GIFlate.exchange(true))
+                ++m_GIFdroppedFrames;
+
+            return false;
         }
+
+        frame           = std::move(m_GIFframes[m_GIFframesHead]);
+        m_GIFframesHead = (m_GIFframesHead + 1) % GIFMaxFrames;
+        --m_GIFframesCount;
+        m_GIFlate = false;
+    }
+
+    Glib::RefPtr<Gdk::Pixbuf> shown;
+    {
+        std::scoped_lock lock{ m_Mutex };
+        shown          = std::move(m_GIFprevFrame);
+        m_GIFprevFrame = std::move(m_Pixbuf);
+        m_Pixbuf       = frame.pixbuf;
+        m_GIFdelay     = frame.delay;
+        m_GIFcurFrame  = frame.index;
     }
 
-    create_gif_frame_pixbuf();
+    // Give the frame from two advances ago back to the decoder
+    if (shown && shown != m_GIFfirstFrame)
+    {
+        std::scoped_lock lock{ m_GIFmutex };
+        m_GIFslots.push_back(std::move(shown));
+    }
+    m_GIFcond.notify_one();
 
-    return get_gif_finished_looping();
-}
+    m_GIFfinished = frame.last;
+    m_SignalPixbufChanged();
 
-bool Image::get_gif_finished_looping() const
-{
-    const nsgif_info_t *info = nsgif_get_info(m_GIFanim);
-    return m_GIFanim && m_GIFcurLoop == info->loop_max &&
-           m_GIFcurFrame == info->frame_count - 1;
+    return true;
 }
 
 unsigned int Image::get_gif_frame_delay() const
@@ -374,16 +908,230 @@ unsigned int Image::get_gif_frame_delay() const
 
     // libnsgif stores delay in centiseconds, convert it to milliseconds.
     // if delay is 0, use a 100ms delay by default
-    return m_GIFdelay ? m_GIFdelay * 10 : 100;
+    return m_GIFdelay && m_GIFdelay != NSGIF_INFINITE ? m_GIFdelay * 10 : 100;
 }
 
 void Image::reset_gif_animation()
 {
+    stop_gif_decoder();
+
+#ifndef NDEBUG
+    if (m_GIFdroppedFrames > 0)
+        std::cerr << "Image: " << m_GIFdroppedFrames << " GIF frames were dropped while playing "
+                  << m_Path << std::endl;
+#endif // !NDEBUG
+
+    m_GIFdroppedFrames = 0;
+    m_GIFfinished      = false;
+
+    std::scoped_lock lock{ m_Mutex };
     m_GIFcurFrame = 0;
-    m_GIFcurLoop  = 1;
 
-    if (m_GIFanim)
-        m_Pixbuf.reset();
+    if (m_GIFanim && m_GIFfirstFrame)
+    {
+        m_Pixbuf = m_GIFfirstFrame;
+        // The stopped decoder thread could still be decoding a frame, the next one resets the
+        // animation and skips the first frame which is already being shown
+        m_GIFrewind = true;
+    }
+}
+
+// Tells the decoder thread to stop without waiting for it, joining it here would block the
+// GTK thread until the frame that is being decoded is done.  When destroy_anim is set the
+// animation is passed along with the thread and m_GIFanim is left null, must be called with
+// m_Mutex locked then
+void Image::stop_gif_decoder(const bool destroy_anim)
+{
+    bool pending{ false };
+
+    if (m_GIFthread.joinable())
+    {
+        pending   = true;
+        m_GIFstop = true;
+        m_GIFcond.notify_one();
+        // start_gif_decoder waits for the previous thread so there is no other exit pending
+        m_GIFexit         = std::make_shared<GIFDecoderExit>();
+        m_GIFexit->thread = std::move(m_GIFthread);
+    }
+
+    if (m_GIFexit)
+    {
+        {
+            std::scoped_lock lock{ m_GIFexit->mutex };
+            // Only the animation the thread was started with, anything loaded after it was
+            // stopped can be freed right away
+            if (destroy_anim && m_GIFanim && m_GIFexit->thread.joinable() && !m_GIFexit->anim)
+            {
+                m_GIFexit->anim   = m_GIFanim;
+                m_GIFexit->data   = m_GIFdata;
+                m_GIFexit->mapped = m_GIFmapped;
+                m_GIFanim         = nullptr;
+                m_GIFdata         = nullptr;
+                m_GIFmapped       = nullptr;
+                m_GIFdataSize     = 0;
+                pending           = true;
+            }
+        }
+
+        if (pending)
+            Executor::get_instance().push([exit = m_GIFexit]() { exit->finish(); });
+    }
+
+    std::scoped_lock lock{ m_GIFmutex };
+    for (auto& f : m_GIFframes)
+        f.pixbuf.reset();
+    m_GIFframesHead = m_GIFframesCount = 0;
+    m_GIFslots.clear();
+    m_GIFprevFrame.reset();
+    m_GIFlate = false;
+}
+
+// Joins the stopped decoder thread if the background task hasn't yet
+void Image::wait_gif_decoder()
+{
+    if (m_GIFexit)
+    {
+        m_GIFexit->finish();
+        m_GIFexit.reset();
+    }
+}
+
+void Image::GIFDecoderExit::finish()
+{
+    std::scoped_lock lock{ mutex };
+
+    if (thread.joinable())
+        thread.join();
+
+    if (anim)
+        free_gif(anim, data, mapped);
+
+    anim   = nullptr;
+    data   = nullptr;
+    mapped = nullptr;
+}
+
+// Returns a pixbuf that isn't being used for the decoder thread to draw the next frame into.
+// Pixbufs of a different size are left over from before the ImageBox was resized or zoomed
+// and are dropped
+Glib::RefPtr<Gdk::Pixbuf> Image::get_gif_slot(const int w, const int h)
+{
+    {
+        std::scoped_lock lock{ m_GIFmutex };
+        while (!m_GIFslots.empty())
+        {
+            Glib::RefPtr<Gdk::Pixbuf> slot{ std::move(m_GIFslots.back()) };
+            m_GIFslots.pop_back();
+
+            if (slot->get_width() == w && slot->get_height() == h)
+                return slot;
+        }
+    }
+
+    return Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, w, h);
+}
+
+// Decodes frames ahead of the ImageBox until m_GIFframes is full, the animation
+// ends, or it is stopped by stop_gif_decoder
+void Image::gif_decoder_thread(nsgif_t* anim)
+{
+    const bool rewind{ m_GIFrewind.exchange(false) };
+    bool skip_first{ rewind };
+
+    if (rewind)
+        nsgif_reset(anim);
+
+    const nsgif_info_t* info{ nsgif_get_info(anim) };
+    // nsgif decodes every frame into the same bitmap, so the same pixbuf can wrap it
+    // for the whole animation
+    Glib::RefPtr<Gdk::Pixbuf> source;
+    nsgif_bitmap_t* source_bitmap{ nullptr };
+
+    while (!m_GIFstop)
+    {
+        int w, h;
+        {
+            std::unique_lock<std::mutex> lock{ m_GIFmutex };
+            m_GIFcond.wait(lock,
+                           [&]() { return m_GIFstop || m_GIFframesCount < m_GIFringSize; });
+
+            if (m_GIFstop)
+                break;
+
+            w = m_GIFframeWidth;
+            h = m_GIFframeHeight;
+        }
+
+        nsgif_rect_t area;
+        nsgif_bitmap_t* bitmap;
+        uint32_t delay, index;
+        nsgif_error result{ nsgif_frame_prepare(anim, &area, &delay, &index) };
+
+        if (result == NSGIF_OK)
+            result = nsgif_frame_decode(anim, index, &bitmap);
+
+        if (result == NSGIF_ERR_ANIMATION_END)
+            break;
+
+        if (result != NSGIF_OK)
+        {
+            std::cerr << "Error while decoding GIF frame " << index << " of " << m_Path
+                      << std::endl
+                      << "nsgif_error: " << result << std::endl;
+            break;
+        }
+
+        if (std::exchange(skip_first, false) && index == 0)
+            continue;
+
+        if (bitmap != source_bitmap)
+        {
+            source        = Gdk::Pixbuf::create_from_data(static_cast<unsigned char*>(bitmap),
+                                                   Gdk::COLORSPACE_RGB,
+                                                   true,
+                                                   8,
+                                                   info->width,
+                                                   info->height,
+                                                   (info->width * 4 + 3) & ~3);
+            source_bitmap = bitmap;
+        }
+
+        if (w <= 0 || h <= 0)
+        {
+            w = source->get_width();
+            h = source->get_height();
+        }
+
+        Glib::RefPtr<Gdk::Pixbuf> pixbuf{ get_gif_slot(w, h) };
+        if (w != source->get_width() || h != source->get_height())
+            Resampler::scale(source, pixbuf, Resampler::Filter::BILINEAR);
+        else
+            source->copy_area(0, 0, w, h, pixbuf, 0, 0);
+
+        const bool last{ delay == NSGIF_INFINITE };
+        {
+            std::scoped_lock lock{ m_GIFmutex };
+            // stop_gif_decoder has already emptied the ring
+            if (m_GIFstop)
+                break;
+
+            // Keep enough frames to cover GIFBufferTime, short delays need more frames
+            const uint32_t ms{ delay && !last ? delay * 10 : 100 };
+            const size_t max_frames{ GIFMaxBufferBytes /
+                                     std::max<size_t>(pixbuf->get_byte_length(), 1) };
+            m_GIFringSize = std::clamp<size_t>(
+                std::min<size_t>((GIFBufferTime + ms - 1) / ms, max_frames), 2, GIFMaxFrames);
+            m_GIFframes[(m_GIFframesHead + m_GIFframesCount++) % GIFMaxFrames] = {
+                std::move(pixbuf), delay, index, last
+            };
+        }
+
+        if (last)
+            break;
+    }
+
+    if (!m_GIFstop)
+        m_GIFdecoderDone = true;
 }
 
 void Image::trash()
@@ -460,6 +1208,16 @@ Glib::RefPtr<Gdk::Pixbuf> Image::create_pixbuf_at_size(const std::string& path,
                                                        const int h,
                                                        Glib::RefPtr<Gio::Cancellable> c) const
 {
+#ifdef HAVE_LIBJPEG
+    // Decodes JPEGs at a fraction of their size, anything else (including the PNGs in the
+    // thumbnail cache) is left to gdk-pixbuf without mapping the file first
+    if (JpegThumbnailer::is_jpeg(path))
+    {
+        if (auto pixbuf{ JpegThumbnailer::create(path, w, h, c) }; pixbuf || c->is_cancelled())
+            return pixbuf;
+    }
+#endif // HAVE_LIBJPEG
+
     Glib::RefPtr<Gio::File> file{ Gio::File::create_for_path(path) };
     Glib::RefPtr<Gdk::Pixbuf> pixbuf;
 
@@ -483,9 +1241,10 @@ Image::scale_pixbuf(Glib::RefPtr<Gdk::Pixbuf>& pixbuf, const int w, const int h)
     double r = std::min(static_cast<double>(w) / pixbuf->get_width(),
                         static_cast<double>(h) / pixbuf->get_height());
 
-    return pixbuf->scale_simple(std::max(pixbuf->get_width() * r, 20.0),
-                                std::max(pixbuf->get_height() * r, 20.0),
-                                Gdk::INTERP_BILINEAR);
+    return Resampler::scale(pixbuf,
+                            std::max(pixbuf->get_width() * r, 20.0),
+                            std::max(pixbuf->get_height() * r, 20.0),
+                            Resampler::Filter::LANCZOS);
 }
 
 // TODO: make this cancellable
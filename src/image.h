@@ -9,9 +9,14 @@ extern "C"
 }
 
 #include "config.h"
+#include "thumbnailpack.h"
 #include "util.h"
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread>
 
@@ -43,30 +48,113 @@ namespace AhoViewer
         virtual std::string get_filename() const;
         virtual const Glib::RefPtr<Gdk::Pixbuf>& get_pixbuf();
         virtual const Glib::RefPtr<Gdk::Pixbuf>& get_thumbnail(Glib::RefPtr<Gio::Cancellable> c);
+        // Frees the thumbnail, the next get_thumbnail call will load it again
+        void reset_thumbnail() { m_ThumbnailPixbuf.reset(); }
+        // When set get_thumbnail will look in the pack before loading or creating the
+        // thumbnail, and add it to the pack afterwards
+        void set_thumbnail_pack(std::shared_ptr<ThumbnailPack> pack)
+        {
+            m_ThumbnailPack = std::move(pack);
+        }
 
         const std::vector<Note>& get_notes() const { return m_Notes; }
 
         virtual void load_pixbuf(Glib::RefPtr<Gio::Cancellable> c);
         virtual void reset_pixbuf();
 
+        // Copies of the pixbuf scaled to the size the ImageBox draws them at.
+        // The cache threads create these ahead of time so switching images doesn't
+        // need to scale the pixbuf.  Animated GIFs and images that are still loading
+        // never have a scaled copy
+        Glib::RefPtr<Gdk::Pixbuf> get_scaled_pixbuf(const int w, const int h);
+        void set_scaled_pixbuf(const Glib::RefPtr<Gdk::Pixbuf>& source,
+                               const Glib::RefPtr<Gdk::Pixbuf>& scaled);
+        void create_scaled_pixbuf(const DisplayArea& area);
+        void reset_scaled_pixbuf();
+
+        // When DecodeAtScale is enabled load_pixbuf will decode images that are much larger
+        // than this area at the size they will be drawn at
+        void set_decode_area(const DisplayArea& area);
+        // True when the pixbuf was decoded at a reduced size
+        bool is_reduced() const { return m_Reduced; }
+        // Returns true if the reduced pixbuf is smaller than it would be drawn in area
+        bool needs_larger_pixbuf(const DisplayArea& area);
+        // Makes the next load_pixbuf call replace the reduced pixbuf with the full image,
+        // returns false if the full image has already been requested or isn't needed
+        bool request_full_size();
+        // Size of the full image, even when the pixbuf is reduced
+        void get_original_size(int& w, int& h);
+
+        // Power of two mipmaps of the pixbuf, each half the size of the previous one.
+        // These are only built by the cache threads after request_mipmaps is called
+        // (when manually zooming out of large images).
+        // request_mipmaps returns false if they were already requested or built
+        bool request_mipmaps();
+        void create_mipmaps(Glib::RefPtr<Gio::Cancellable> c);
+        // Returns the smallest mipmap that is at least scale times the size of the pixbuf,
+        // or the pixbuf itself when there is no such mipmap
+        Glib::RefPtr<Gdk::Pixbuf> get_mipmap(const double scale);
+        std::vector<Glib::RefPtr<Gdk::Pixbuf>> get_mipmaps();
+
+        // Number of bytes used by the decoded image, this includes the GIF
+        // frame bitmap, the GIF file data, the scaled copy and mipmaps
+        size_t get_memory_size();
+        // Guesses the decoded size from the image header when the image hasn't been loaded
+        // yet.  This reads the file so it is only done by the cache workers, the getter
+        // returns 0 until then or if the size cannot be determined (not downloaded/extracted)
+        void estimate_memory_size();
+        size_t get_estimated_memory_size() const { return m_EstimatedMemorySize; }
+
+        // Used by the image list cache to evict the least recently viewed images first
+        std::chrono::steady_clock::time_point get_last_access() const { return m_LastAccess; }
+        void update_last_access() { m_LastAccess = std::chrono::steady_clock::now(); }
+
+        // Animated GIF frames are decoded ahead of time by a separate thread, which is
+        // started by the ImageBox when it starts the animation.  If the frame size is set
+        // the frames are also scaled to that size by the decoder thread
+        void start_gif_decoder();
+        void set_gif_frame_size(const int w, const int h);
+        // Shows the next decoded frame, returns false if it hasn't been decoded yet.
+        // Every time this happens the frame is counted as dropped
         bool gif_advance_frame();
-        bool get_gif_finished_looping() const;
+        bool get_gif_finished_looping() const { return m_GIFfinished; }
         unsigned int get_gif_frame_delay() const;
+        size_t get_gif_dropped_frames() const { return m_GIFdroppedFrames; }
+        // Stops the decoder thread and rewinds the animation to the first frame
         void reset_gif_animation();
 
         void trash();
 
         Glib::Dispatcher& signal_pixbuf_changed() { return m_SignalPixbufChanged; }
         Glib::Dispatcher& signal_notes_changed() { return m_SignalNotesChanged; }
+        // Emitted from the loading thread as large files are read, see get_load_progress
+        Glib::Dispatcher& signal_load_progress() { return m_SignalLoadProgress; }
+
+        // Bytes read by the current load, only updated for files of at least
+        // ProgressiveLoadSize bytes
+        void get_load_progress(size_t& current, size_t& total) const
+        {
+            current = m_LoadCurrent;
+            total   = m_LoadTotal;
+        }
 
         static const size_t ThumbnailSize{ 100 };
+        // Local files at least this large are drawn while they are being decoded
+        static constexpr size_t ProgressiveLoadSize{ 4 * 1024 * 1024 };
+        // Mipmaps smaller than this in either dimension are not created
+        static const int MipmapMinSize{ 64 };
 
     protected:
         static bool is_webm(const std::string&);
 
         bool load_gif(nsgif_t* anim, size_t data_size, uint8_t* data);
         void create_gif_frame_pixbuf();
+        void stop_gif_decoder(const bool destroy_anim = false);
         bool is_gif(const unsigned char* data);
+        Glib::RefPtr<Gdk::Pixbuf> load_incremental(const Glib::RefPtr<Gio::File>& file,
+                                                   const int w,
+                                                   const int h,
+                                                   Glib::RefPtr<Gio::Cancellable> c);
         void create_thumbnail(Glib::RefPtr<Gio::Cancellable> c, bool save = true);
         Glib::RefPtr<Gdk::Pixbuf> create_pixbuf_at_size(const std::string& path,
                                                         const int w,
@@ -78,20 +166,87 @@ namespace AhoViewer
         std::string m_Path, m_ThumbnailPath;
 
         Glib::RefPtr<Gdk::Pixbuf> m_ThumbnailPixbuf;
-        Glib::RefPtr<Gdk::Pixbuf> m_Pixbuf;
+        std::shared_ptr<ThumbnailPack> m_ThumbnailPack;
+        Glib::RefPtr<Gdk::Pixbuf> m_Pixbuf, m_ScaledPixbuf;
+        // The pixbuf that m_ScaledPixbuf was created from, only used for comparison
+        const GdkPixbuf* m_ScaledSource{ nullptr };
 
         nsgif_t* m_GIFanim{ nullptr };
         unsigned char* m_GIFdata{ nullptr };
+        size_t m_GIFdataSize{ 0 };
+        // Set when m_GIFdata is the contents of a mapped file rather than a g_malloc'd copy
+        GMappedFile* m_GIFmapped{ nullptr };
         uint32_t m_GIFcurFrame{ 0 }, m_GIFdelay{ 0 };
         nsgif_bitmap_cb_vt m_BitmapCallbacks;
-        int m_GIFcurLoop{ 1 };
+        // A copy of the first frame, shown again when the animation is reset
+        Glib::RefPtr<Gdk::Pixbuf> m_GIFfirstFrame;
 
         std::vector<Note> m_Notes;
 
+        // Guarded by m_Mutex, cleared whenever m_Pixbuf is replaced
+        std::vector<Glib::RefPtr<Gdk::Pixbuf>> m_Mipmaps;
+
+        DisplayArea m_DecodeArea;
+        std::atomic<bool> m_Reduced{ false }, m_WantFullSize{ false }, m_WantMipmaps{ false };
+        int m_FullWidth{ 0 }, m_FullHeight{ 0 };
+
+        std::atomic<size_t> m_EstimatedMemorySize{ 0 };
+        std::chrono::steady_clock::time_point m_LastAccess;
+
         std::mutex m_Mutex;
-        Glib::Dispatcher m_SignalPixbufChanged, m_SignalNotesChanged;
+        std::atomic<size_t> m_LoadCurrent{ 0 }, m_LoadTotal{ 0 };
+        Glib::Dispatcher m_SignalPixbufChanged, m_SignalNotesChanged, m_SignalLoadProgress;
 
     private:
+        struct GIFFrame
+        {
+            Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+            uint32_t delay, index;
+            // The last frame of an animation that doesn't loop forever
+            bool last;
+        };
+
+        // A decoder thread that was told to stop, and the animation it was using once that has
+        // been reset.  Joined and freed on a background task, or by whichever of
+        // start_gif_decoder and the destructor needs it done first
+        struct GIFDecoderExit
+        {
+            std::mutex mutex;
+            std::thread thread;
+            nsgif_t* anim{ nullptr };
+            unsigned char* data{ nullptr };
+            GMappedFile* mapped{ nullptr };
+
+            void finish();
+        };
+
+        void gif_decoder_thread(nsgif_t* anim);
+        void wait_gif_decoder();
+        Glib::RefPtr<Gdk::Pixbuf> get_gif_slot(const int w, const int h);
+
+        static constexpr size_t LoadChunkSize{ 256 * 1024 };
+        static constexpr uint32_t GIFBufferTime{ 500 };
+        static constexpr size_t GIFMaxFrames{ 16 }, GIFMaxBufferBytes{ 32 * 1024 * 1024 };
+
+        // Frames waiting to be shown, a fixed size ring guarded by m_GIFmutex.  The decoder
+        // keeps up to m_GIFringSize frames ahead, enough to cover GIFBufferTime of the animation
+        std::array<GIFFrame, GIFMaxFrames> m_GIFframes;
+        size_t m_GIFframesHead{ 0 }, m_GIFframesCount{ 0 }, m_GIFringSize{ 2 };
+        // Frame pixbufs that have been shown and can be reused by the decoder thread,
+        // guarded by m_GIFmutex.  Once the ring is full no new pixbufs are created
+        std::vector<Glib::RefPtr<Gdk::Pixbuf>> m_GIFslots;
+        // The frame shown before m_Pixbuf, the ImageBox can still be showing it so it isn't
+        // reused until the next frame is shown
+        Glib::RefPtr<Gdk::Pixbuf> m_GIFprevFrame;
+        int m_GIFframeWidth{ 0 }, m_GIFframeHeight{ 0 };
+        std::thread m_GIFthread;
+        std::shared_ptr<GIFDecoderExit> m_GIFexit;
+        std::mutex m_GIFmutex;
+        std::condition_variable m_GIFcond;
+        std::atomic<bool> m_GIFstop{ false }, m_GIFdecoderDone{ false }, m_GIFfinished{ false },
+            m_GIFlate{ false }, m_GIFrewind{ false };
+        std::atomic<size_t> m_GIFdroppedFrames{ 0 };
+
         Glib::RefPtr<Gdk::Pixbuf>
         scale_pixbuf(Glib::RefPtr<Gdk::Pixbuf>& pixbuf, const int w, const int h) const;
 
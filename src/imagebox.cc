@@ -4,6 +4,7 @@ using namespace AhoViewer;
 #include "application.h"
 #include "imageboxnote.h"
 #include "mainwindow.h"
+#include "resample.h"
 #include "settings.h"
 #include "statusbar.h"
 #include "videobox.h"
@@ -42,6 +43,8 @@ ImageBox::ImageBox(BaseObjectType* cobj, const Glib::RefPtr<Gtk::Builder>& bldr)
     bldr->get_widget_derived("VideoBox", m_VideoBox);
     bldr->get_widget_derived("StatusBar", m_StatusBar);
 
+    m_GtkImage->signal_draw().connect(sigc::mem_fun(*this, &ImageBox::on_image_draw), false);
+
     m_StyleUpdatedConn = m_Fixed->signal_style_updated().connect(
         [&]() { m_Fixed->get_style_context()->lookup_color("theme_bg_color", DefaultBGColor); });
 }
@@ -107,6 +110,8 @@ void ImageBox::clear_image()
     m_DrawConn.disconnect();
     m_AnimConn.disconnect();
     m_GtkImage->clear();
+    m_GtkImage->set_size_request(-1, -1);
+    m_TileRenderer.clear();
     m_Overlay->hide();
     m_VideoBox->hide();
     m_Fixed->set_size_request(0, 0);
@@ -348,38 +353,28 @@ bool ImageBox::on_scroll_event(GdkEventScroll* e)
 // It sets the values of w, h to their scaled values, and x, y to center
 // coordinates for m_Fixed to use
 // returns the drawable area's width and height
-void ImageBox::get_scale_and_position(int& w, int& h, int& x, int& y)
+DisplayArea ImageBox::get_display_area() const
 {
-    int ww, wh;
-    m_MainWindow->get_drawable_area_size(ww, wh);
+    DisplayArea area{ 0, 0, m_ZoomMode, m_ZoomPercent };
+    m_MainWindow->get_drawable_area_size(area.width, area.height);
 
-    w = m_OrigWidth;
-    h = m_OrigHeight;
+    return area;
+}
 
-    double window_aspect = static_cast<double>(ww) / wh, image_aspect = static_cast<double>(w) / h;
+void ImageBox::get_scale_and_position(int& w, int& h, int& x, int& y)
+{
+    DisplayArea area{ get_display_area() };
+    area.get_scaled_size(m_OrigWidth, m_OrigHeight, w, h);
 
-    // These do not take the scrollbar size in to account, because I assume that
-    // overlay scrollbars are enabled
-    if (w > ww && (m_ZoomMode == ZoomMode::FIT_WIDTH ||
-                   (m_ZoomMode == ZoomMode::AUTO_FIT && window_aspect <= image_aspect)))
-    {
-        w = ww;
-        h = std::ceil(w / image_aspect);
-    }
-    else if (h > wh && (m_ZoomMode == ZoomMode::FIT_HEIGHT ||
-                        (m_ZoomMode == ZoomMode::AUTO_FIT && window_aspect >= image_aspect)))
-    {
-        h = wh;
-        w = std::ceil(h * image_aspect);
-    }
-    else if (m_ZoomMode == ZoomMode::MANUAL && m_ZoomPercent != 100)
+    x = std::max(0, (area.width - w) / 2);
+    y = std::max(0, (area.height - h) / 2);
+
+    // Let the image lists know so they can scale their cached images to match
+    if (area != m_DisplayArea)
     {
-        w *= static_cast<double>(m_ZoomPercent) / 100;
-        h *= static_cast<double>(m_ZoomPercent) / 100;
+        m_DisplayArea = area;
+        m_SignalDisplayAreaChanged(m_DisplayArea);
     }
-
-    x = std::max(0, (ww - w) / 2);
-    y = std::max(0, (wh - h) / 2);
 }
 
 void ImageBox::draw_image(bool scroll)
@@ -411,9 +406,12 @@ void ImageBox::draw_image(bool scroll)
         {
             m_AnimConn.disconnect();
             if (!m_Image->get_gif_finished_looping())
+            {
+                m_Image->start_gif_decoder();
                 m_AnimConn = Glib::signal_timeout().connect(
                     sigc::mem_fun(*this, &ImageBox::update_animation),
                     m_Image->get_gif_frame_delay());
+            }
         }
 
         Glib::RefPtr<Gdk::Pixbuf> pixbuf = m_Image->get_pixbuf();
@@ -423,8 +421,13 @@ void ImageBox::draw_image(bool scroll)
             // Set this here incase we dont need to scale
             temp_pixbuf = pixbuf;
 
-            m_OrigWidth  = pixbuf->get_width();
-            m_OrigHeight = pixbuf->get_height();
+            // Reduced images are treated as if they were the full size image
+            m_Image->get_original_size(m_OrigWidth, m_OrigHeight);
+            if (m_OrigWidth == 0 || m_OrigHeight == 0)
+            {
+                m_OrigWidth  = pixbuf->get_width();
+                m_OrigHeight = pixbuf->get_height();
+            }
         }
         else
         {
@@ -449,8 +452,52 @@ void ImageBox::draw_image(bool scroll)
     get_scale_and_position(w, h, x, y);
     m_Scale =
         m_ZoomMode == ZoomMode::MANUAL ? m_ZoomPercent : static_cast<double>(w) / m_OrigWidth * 100;
-    if (!m_Image->is_webm() && !error && (w != m_OrigWidth || h != m_OrigHeight))
-        temp_pixbuf = m_Image->get_pixbuf()->scale_simple(w, h, Gdk::INTERP_BILINEAR);
+    // Let the decoder thread scale the upcoming frames
+    if (m_Image->is_animated_gif() && !error)
+        m_Image->set_gif_frame_size(w, h);
+
+    bool tiled{ false };
+    if (!m_Image->is_webm() && !error &&
+        (w != temp_pixbuf->get_width() || h != temp_pixbuf->get_height()))
+    {
+        const double scale{ static_cast<double>(w) / temp_pixbuf->get_width() };
+
+        // Images that are much larger than the window are drawn in tiles by on_image_draw
+        // so only the visible part of them is ever scaled
+        tiled = !m_Loading && !m_Image->is_animated_gif() && get_display_area().use_tiles(w, h);
+
+        // The reduced pixbuf will be replaced by the full image once it has loaded
+        if (m_Image->is_reduced() &&
+            (w > temp_pixbuf->get_width() || h > temp_pixbuf->get_height()) &&
+            m_Image->request_full_size())
+            m_SignalReloadRequested();
+        // Zooming out of large images will scale from the closest mipmap once they are built
+        else if ((m_ZoomMode == ZoomMode::MANUAL || tiled) && scale <= 0.5 &&
+                 m_Image->request_mipmaps())
+            m_SignalReloadRequested();
+
+        if (tiled)
+        {
+            m_TileRenderer.set_pixbuf(temp_pixbuf, m_Image->get_mipmaps());
+            m_TileRenderer.set_scale(scale);
+        }
+        else
+        {
+            // Cached images will usually have been scaled to this size already
+            Glib::RefPtr<Gdk::Pixbuf> pixbuf{ temp_pixbuf };
+            temp_pixbuf = m_Image->get_scaled_pixbuf(w, h);
+            if (!temp_pixbuf)
+            {
+                Glib::RefPtr<Gdk::Pixbuf> source{ m_Image->get_mipmap(scale) };
+                temp_pixbuf = Resampler::scale(
+                    source ? source : pixbuf, w, h, Resampler::Filter::BILINEAR);
+                m_Image->set_scaled_pixbuf(pixbuf, temp_pixbuf);
+            }
+        }
+    }
+
+    if (!tiled)
+        m_TileRenderer.clear();
 
     double h_adjust_val{ 0 }, v_adjust_val{ 0 };
 
@@ -472,7 +519,17 @@ void ImageBox::draw_image(bool scroll)
     if (temp_pixbuf)
     {
         m_Fixed->move(*m_Overlay, x, y);
-        m_GtkImage->set(temp_pixbuf);
+        if (tiled)
+        {
+            m_GtkImage->clear();
+            m_GtkImage->set_size_request(w, h);
+            m_GtkImage->queue_draw();
+        }
+        else
+        {
+            m_GtkImage->set_size_request(-1, -1);
+            m_GtkImage->set(temp_pixbuf);
+        }
         m_Overlay->show();
     }
 #ifdef HAVE_GSTREAMER
@@ -546,9 +603,12 @@ bool ImageBox::update_animation()
     if (m_Image->is_loading())
         return true;
 
-    bool gif_finished{ m_Image->gif_advance_frame() };
-
-    if (!gif_finished)
+    // The decoder thread has fallen behind, check again shortly instead of waiting
+    // for another frame delay
+    if (!m_Image->gif_advance_frame())
+        m_AnimConn = Glib::signal_timeout().connect(
+            sigc::mem_fun(*this, &ImageBox::update_animation), GIFRetryDelay);
+    else if (!m_Image->get_gif_finished_looping())
         m_AnimConn = Glib::signal_timeout().connect(
             sigc::mem_fun(*this, &ImageBox::update_animation), m_Image->get_gif_frame_delay());
 
@@ -676,11 +736,34 @@ void ImageBox::zoom(const std::uint32_t percent)
     if (m_ZoomMode != ZoomMode::MANUAL || percent < 10 || percent > 400)
         return;
 
+    if (!m_ZoomPending)
+    {
+        m_ZoomStart   = std::chrono::steady_clock::now();
+        m_ZoomPending = true;
+    }
+
     m_ZoomScroll  = m_ZoomPercent != percent;
     m_ZoomPercent = percent;
     queue_draw_image();
 }
 
+// Tiled images are drawn here, otherwise the Gtk::Image draws the pixbuf itself
+bool ImageBox::on_image_draw(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+    const bool drawn{ m_TileRenderer.draw(cr) };
+
+    if (m_ZoomPending && !m_RedrawQueued)
+    {
+        m_ZoomPending = false;
+        auto ms{ std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - m_ZoomStart)
+                     .count() };
+        m_StatusBar->set_message(Glib::ustring::compose(_("Zoom took %1 ms"), ms));
+    }
+
+    return drawn;
+}
+
 bool ImageBox::advance_slideshow()
 {
     scroll(0, 300, false, true);
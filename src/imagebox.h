@@ -2,6 +2,7 @@
 
 #include "config.h"
 #include "image.h"
+#include "tilerenderer.h"
 #include "util.h"
 
 #include <gtkmm.h>
@@ -39,6 +40,8 @@ namespace AhoViewer
         ZoomMode get_zoom_mode() const { return m_ZoomMode; }
         void set_zoom_mode(const ZoomMode);
 
+        DisplayArea get_display_area() const;
+
         ScrollPos get_scroll_position() const
         {
             return { get_hadjustment()->get_value(), get_vadjustment()->get_value(), m_ZoomMode };
@@ -48,8 +51,17 @@ namespace AhoViewer
 
         sigc::signal<void> signal_slideshow_ended() const { return m_SignalSlideshowEnded; }
         sigc::signal<void> signal_image_drawn() const { return m_SignalImageDrawn; }
+        sigc::signal<void, const DisplayArea&> signal_display_area_changed() const
+        {
+            return m_SignalDisplayAreaChanged;
+        }
+        // Emitted when the current image needs the cache threads to load its full size
+        // pixbuf (it was loaded at a reduced size and is zoomed past it) or its mipmaps
+        sigc::signal<void> signal_reload_requested() const { return m_SignalReloadRequested; }
 
         static Gdk::RGBA DefaultBGColor;
+        // Milliseconds to wait for a GIF frame that wasn't decoded in time
+        static constexpr unsigned int GIFRetryDelay{ 5 };
 
         // Action callbacks {{{
         void on_zoom_in();
@@ -90,6 +102,7 @@ namespace AhoViewer
 
         bool advance_slideshow();
         bool on_cursor_timeout();
+        bool on_image_draw(const Cairo::RefPtr<Cairo::Context>& cr);
         void on_notes_changed();
         void clear_notes();
         void update_notes();
@@ -117,12 +130,18 @@ namespace AhoViewer
             m_ZoomScroll{ false };
         ZoomMode m_ZoomMode;
         ScrollPos m_RestoreScrollPos;
+        DisplayArea m_DisplayArea;
         // TODO: add setting for this
         uint32_t m_ZoomPercent{ 100 };
         double m_Scale{ 0 }, m_PressX, m_PreviousX, m_PressY, m_PreviousY;
+        // Time of the first zoom step that hasn't been drawn yet, shown in the statusbar
+        std::chrono::steady_clock::time_point m_ZoomStart;
+        bool m_ZoomPending{ false };
 
         std::vector<ImageBoxNote*> m_Notes;
+        TileRenderer m_TileRenderer;
 
-        sigc::signal<void> m_SignalSlideshowEnded, m_SignalImageDrawn;
+        sigc::signal<void> m_SignalSlideshowEnded, m_SignalImageDrawn, m_SignalReloadRequested;
+        sigc::signal<void, const DisplayArea&> m_SignalDisplayAreaChanged;
     };
 }
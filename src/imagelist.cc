@@ -2,17 +2,24 @@
 using namespace AhoViewer;
 
 #include "booru/image.h"
-#include "naturalsort.h"
 #include "settings.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <limits>
 #include <numeric>
 #include <thread>
 
+#ifndef _WIN32
+#include <dirent.h>
+#endif // !_WIN32
+
 ImageList::ImageList(Widget* const w)
     : m_Widget{ w },
       m_ScrollPos{ -1, -1, ZoomMode::AUTO_FIT },
-      m_ThumbnailCancel{ Gio::Cancellable::create() },
-      m_CacheCancel{ Gio::Cancellable::create() }
+      m_ThumbnailCancel{ Gio::Cancellable::create() }
 {
     // Sorts indices based on how close they are to m_Index
     m_IndexSort = [=](size_t a, size_t b) {
@@ -26,25 +33,30 @@ ImageList::ImageList(Widget* const w)
 
     m_ThumbnailLoadedConn =
         m_SignalThumbnailLoaded.connect(sigc::mem_fun(*this, &ImageList::on_thumbnail_loaded));
-
-    m_CacheThread = std::thread([&]() {
-        while (!m_CacheStop)
-        {
-            {
-                std::unique_lock<std::mutex> lock(m_CacheMutex);
-                m_CacheCond.wait(lock, [&]() { return !m_CacheQueue.empty() || m_CacheStop; });
-            }
-
-            std::shared_ptr<Image> img = nullptr;
-            while (!m_CacheCancel->is_cancelled() && m_CacheQueue.pop(img))
-                img->load_pixbuf(m_CacheCancel);
-        }
+    // Scrolling can emit this many times per frame, only update once
+    m_Widget->signal_visible_range_changed().connect([&]() {
+        if (!m_VisibleRangeConn)
+            m_VisibleRangeConn = Glib::signal_idle().connect([&]() {
+                update_thumbnails();
+                return false;
+            });
     });
+    m_CacheLoadedConn =
+        m_SignalCacheLoaded.connect(sigc::mem_fun(*this, &ImageList::on_cache_loaded));
+    m_EntriesLoadedConn =
+        m_SignalEntriesLoaded.connect(sigc::mem_fun(*this, &ImageList::on_entries_loaded));
 }
 
 ImageList::~ImageList()
 {
     m_ThumbnailLoadedConn.disconnect();
+    m_ThumbnailFlushConn.disconnect();
+    m_VisibleRangeConn.disconnect();
+    m_CacheLoadedConn.disconnect();
+    m_EntriesLoadedConn.disconnect();
+    m_FileChangesConn.disconnect();
+    cancel_entries();
+    m_DisplayAreaConn.disconnect();
 
     if (m_FileMonitor)
     {
@@ -55,9 +67,13 @@ ImageList::~ImageList()
     cancel_thumbnail_thread();
 
     cancel_cache();
-    m_CacheStop = true;
-    m_CacheCond.notify_one();
-    m_CacheThread.join();
+    m_CacheGroup.cancel();
+
+#ifndef NDEBUG
+    if (m_CacheWastedLoads > 0)
+        std::cerr << "ImageList: " << m_CacheWastedLoads << " cached image loads were wasted"
+                  << std::endl;
+#endif // !NDEBUG
 }
 
 void ImageList::clear()
@@ -99,8 +115,15 @@ bool ImageList::load(const std::string path, std::string& error, int index)
         return false;
     }
 
-    std::vector<std::string> entries{ archive ? archive->get_entries(Archive::IMAGES)
-                                              : get_entries<Image>(dir_path) };
+    // When opening a single image it is shown right away, the rest of the directory
+    // is read and sorted by load_entries and merged into the list afterwards
+    const bool incremental{ !archive && path != dir_path };
+    std::vector<std::string> entries;
+
+    if (incremental)
+        entries.push_back(path);
+    else
+        entries = archive ? archive->get_entries(Archive::IMAGES) : get_entries<Image>(dir_path);
 
     // No valid images in this directory
     if (entries.empty())
@@ -120,7 +143,7 @@ bool ImageList::load(const std::string path, std::string& error, int index)
     {
         m_Archive        = std::move(archive);
         m_ArchiveEntries = get_entries<Archive>(Glib::path_get_dirname(m_Archive->get_path()));
-        std::sort(m_ArchiveEntries.begin(), m_ArchiveEntries.end(), NaturalSort());
+        NaturalSort::sort(m_ArchiveEntries);
     }
     else
     {
@@ -128,9 +151,18 @@ bool ImageList::load(const std::string path, std::string& error, int index)
         m_FileMonitor               = dir->monitor_directory();
         m_FileMonitor->signal_changed().connect(
             sigc::mem_fun(*this, &ImageList::on_directory_changed));
+
+        if (Settings.get_bool("ThumbnailPack"))
+        {
+            m_ThumbnailPack = std::make_shared<ThumbnailPack>(dir_path);
+            Executor::get_instance().push([pack = m_ThumbnailPack]() { pack->clean(); });
+        }
     }
 
-    std::sort(entries.begin(), entries.end(), NaturalSort());
+    if (m_Archive)
+        NaturalSort::sort(entries);
+    else
+        NaturalSort::sort(entries, m_SortKeys);
 
     if (path != dir_path && !m_Archive)
     {
@@ -149,12 +181,20 @@ bool ImageList::load(const std::string path, std::string& error, int index)
             img = std::make_shared<Archive::Image>(e, *m_Archive);
         else
             img = std::make_shared<Image>(e);
+        img->set_thumbnail_pack(m_ThumbnailPack);
         m_Images.push_back(std::move(img));
     }
 
+    if (!m_Archive)
+        index_paths();
+
     m_SignalLoadSuccess();
     set_current(index, false, true);
-    m_ThumbnailThread = std::thread(sigc::mem_fun(*this, &ImageList::load_thumbnails));
+    load_thumbnails();
+
+    if (incremental)
+        m_EntriesThread =
+            std::thread(sigc::bind(sigc::mem_fun(*this, &ImageList::load_entries), dir_path));
 
     return true;
 }
@@ -209,20 +249,64 @@ void ImageList::on_cache_size_changed()
         update_cache();
 }
 
+void ImageList::set_display_area(const DisplayArea& area)
+{
+    {
+        std::scoped_lock lock{ m_CacheMutex };
+        if (area == m_DisplayArea)
+            return;
+
+        m_DisplayArea = area;
+    }
+
+    // Resizing the window or zooming will change this many times in a row,
+    // wait for it to settle before rescaling the cached images
+    m_DisplayAreaConn.disconnect();
+    m_DisplayAreaConn = Glib::signal_timeout().connect(
+        [&]() {
+            DisplayArea area;
+            {
+                std::scoped_lock lock{ m_CacheMutex };
+                area = m_DisplayArea;
+            }
+
+            // The current image is rescaled by the ImageBox when it's drawn
+            // Images that were decoded smaller than they would now be drawn are reloaded
+            for (const auto i : m_Cache)
+            {
+                if (i == m_Index || i >= m_Images.size())
+                    continue;
+
+                if (m_Images[i]->needs_larger_pixbuf(area))
+                    m_Images[i]->reset_pixbuf();
+                else
+                    m_Images[i]->reset_scaled_pixbuf();
+            }
+
+            if (!empty())
+                update_cache();
+
+            return false;
+        },
+        250);
+}
+
+void ImageList::reload_current()
+{
+    if (!empty())
+        update_cache();
+}
+
 void ImageList::set_current(const size_t index, const bool from_widget, const bool force)
 {
     if (index == m_Index && !force)
         return;
 
+    update_nav_direction(index);
     m_Index = index;
     m_SignalChanged(m_Images[m_Index]);
     update_cache();
-
-    if (m_ThreadPool.active())
-    {
-        cancel_thumbnail_thread();
-        m_ThumbnailThread = std::thread(sigc::mem_fun(*this, &ImageList::load_thumbnails));
-    }
+    update_thumbnails();
 
     if (!from_widget)
         m_Widget->set_selected(m_Index);
@@ -230,45 +314,171 @@ void ImageList::set_current(const size_t index, const bool from_widget, const bo
 
 void ImageList::load_thumbnails()
 {
+    // Thumbnails that were queued before the last cancel will never be loaded
+    if (m_ThumbnailCancel->is_cancelled())
+        std::replace(m_ThumbnailStates.begin(),
+                     m_ThumbnailStates.end(),
+                     ThumbnailState::QUEUED,
+                     ThumbnailState::NONE);
+
     m_ThumbnailCancel->reset();
-    m_ThumbnailsLoading = m_ThumbnailsLoaded = 0;
+    m_ThumbnailStates.resize(m_Images.size(), ThumbnailState::NONE);
+    m_ThumbnailsLoaded = 0;
+    {
+        std::scoped_lock lock{ m_ThumbnailMutex };
+        m_ThumbnailsLoading = m_ThumbnailRequests.size();
+    }
 
-    std::vector<size_t> indices(m_Images.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    std::sort(indices.begin(), indices.end(), m_IndexSort);
+    update_thumbnails();
+}
 
-    for (const size_t i : indices)
+void ImageList::update_thumbnails()
+{
+    if (m_Images.empty() || m_ThumbnailStates.size() != m_Images.size() ||
+        m_ThumbnailCancel->is_cancelled())
+        return;
+
+    size_t start, end;
+    if (!m_Widget->get_visible_range(start, end))
+        start = end = m_Index;
+
+    end   = std::min(end, m_Images.size() - 1);
+    start = std::min(start, end);
+
+    // The visible thumbnails first, followed by the ones closest to them
+    const size_t max_resident{ std::max<size_t>(ThumbnailMaxBytes / m_ThumbnailBytes, 1) },
+        window{ std::min(max_resident, m_Images.size()) };
+    std::vector<size_t> order;
+    order.reserve(window);
+
+    for (size_t i = start; i <= end && order.size() < window; ++i)
+        order.push_back(i);
+
+    for (size_t d = 1; order.size() < window; ++d)
     {
-        if (m_ThumbnailCancel->is_cancelled())
-            break;
+        if (end + d < m_Images.size())
+            order.push_back(end + d);
+        if (d <= start && order.size() < window)
+            order.push_back(start - d);
+    }
+
+    const auto [first, last]{ std::minmax_element(order.begin(), order.end()) };
+    const size_t lo{ *first }, hi{ *last };
+
+    std::scoped_lock lock{ m_ThumbnailMutex };
+
+    // Requests that haven't been started are queued again below if they are still needed
+    for (const size_t i : m_ThumbnailRequests)
+        if (i < m_ThumbnailStates.size())
+            m_ThumbnailStates[i] = ThumbnailState::NONE;
+    m_ThumbnailsLoading -= m_ThumbnailRequests.size();
+    m_ThumbnailRequests.clear();
 
-        // Only load thumbnails that haven't been already
-        auto it = m_Widget->m_ListStore->get_iter(std::to_string(i));
-        if (!it || !it->get_value(m_Widget->m_Columns.pixbuf))
+    for (const size_t i : order)
+    {
+        if (m_ThumbnailStates[i] == ThumbnailState::NONE)
         {
-            m_ThreadPool.push([&, i]() {
-                Glib::RefPtr<Gdk::Pixbuf> thumb = m_Images[i]->get_thumbnail(m_ThumbnailCancel);
+            m_ThumbnailStates[i] = ThumbnailState::QUEUED;
+            m_ThumbnailRequests.push_back(i);
+        }
+    }
+    m_ThumbnailsLoading += m_ThumbnailRequests.size();
 
-                if (!m_ThumbnailCancel->is_cancelled())
-                {
-                    if (!thumb)
-                        thumb = Image::get_missing_pixbuf();
+    // Make room for the new thumbnails by unloading everything outside of the window
+    if (m_ThumbnailsResident + m_ThumbnailRequests.size() > max_resident)
+    {
+        for (size_t i = 0; i < m_ThumbnailStates.size(); ++i)
+            if ((i < lo || i > hi) && m_ThumbnailStates[i] == ThumbnailState::LOADED)
+                unload_thumbnail(i);
+    }
 
-                    m_ThumbnailQueue.emplace(i, std::move(thumb));
-                    ++m_ThumbnailsLoaded;
-                    m_SignalThumbnailLoaded();
+    for (; m_ThumbnailWorkers <
+           std::min(Executor::get_instance().size(), m_ThumbnailRequests.size());
+         ++m_ThumbnailWorkers)
+        push_thumbnail_worker();
+}
+
+// Each worker loads thumbnails until m_ThumbnailRequests is empty, must be called with
+// m_ThumbnailMutex locked and the worker already counted in m_ThumbnailWorkers
+void ImageList::push_thumbnail_worker()
+{
+    m_ThumbnailGroup.push([&, priority = m_ThumbnailGroup.get_priority()]() {
+        size_t i;
+        std::shared_ptr<Image> img;
+
+        while (pop_thumbnail_request(i, img, priority))
+        {
+            Glib::RefPtr<Gdk::Pixbuf> thumb = img->get_thumbnail(m_ThumbnailCancel);
+
+            if (!m_ThumbnailCancel->is_cancelled())
+            {
+                if (!thumb)
+                    thumb = Image::get_missing_pixbuf();
+
+                {
+                    // Images can be inserted or removed while the thumbnail loads, the
+                    // index is fixed here so flush_thumbnails doesn't have to search for it.
+                    // Pushing with the lock held lets merges shift every queued result
+                    std::scoped_lock lock{ m_ThumbnailMutex };
+                    if (i >= m_Images.size() || m_Images[i] != img)
+                        i = std::find(m_Images.begin(), m_Images.end(), img) - m_Images.begin();
+                    if (i < m_Images.size())
+                        m_ThumbnailQueue.push({ i, img, std::move(thumb) });
                 }
-            });
+                ++m_ThumbnailsLoaded;
+                m_SignalThumbnailLoaded();
+            }
+        }
+    });
+}
 
-            ++m_ThumbnailsLoading;
+// Called by the thread pool tasks, returns false once there is nothing left to load and
+// the task should finish
+bool ImageList::pop_thumbnail_request(size_t& index,
+                                      std::shared_ptr<Image>& image,
+                                      const Executor::Priority priority)
+{
+    std::scoped_lock lock{ m_ThumbnailMutex };
+
+    // The group was reprioritized (e.g. its booru page was hidden or shown again).  This
+    // worker holds a running slot of its old priority until it returns, so it hands the
+    // rest of the requests to a worker pushed at the new priority
+    if (m_ThumbnailGroup.get_priority() != priority && !m_ThumbnailRequests.empty() &&
+        !m_ThumbnailCancel->is_cancelled())
+    {
+        push_thumbnail_worker();
+        return false;
+    }
+
+    while (!m_ThumbnailRequests.empty() && !m_ThumbnailCancel->is_cancelled())
+    {
+        index = m_ThumbnailRequests.front();
+        m_ThumbnailRequests.pop_front();
+
+        if (index < m_Images.size())
+        {
+            image = m_Images[index];
+            return true;
         }
     }
+
+    --m_ThumbnailWorkers;
+    return false;
+}
+
+void ImageList::unload_thumbnail(const size_t index)
+{
+    m_Widget->set_pixbuf(index, Glib::RefPtr<Gdk::Pixbuf>{});
+    m_Images[index]->reset_thumbnail();
+    m_ThumbnailStates[index] = ThumbnailState::NONE;
+    --m_ThumbnailsResident;
 }
 
 // Resets the image list to it's initial state
 void ImageList::reset()
 {
     cancel_cache();
+    cancel_entries();
 
     if (m_FileMonitor)
     {
@@ -276,10 +486,24 @@ void ImageList::reset()
         m_FileMonitor.reset();
     }
 
+    m_FileChangesConn.disconnect();
+    m_FileChanges.clear();
+    m_PathIndices.clear();
+    m_SortKeys.clear();
+
     cancel_thumbnail_thread();
 
     m_Images.clear();
     m_Widget->clear();
+    m_ThumbnailPack.reset();
+
+    {
+        std::scoped_lock lock{ m_ThumbnailMutex };
+        m_ThumbnailRequests.clear();
+    }
+    m_ThumbnailStates.clear();
+    m_ThumbnailsResident = 0;
+    m_ThumbnailBytes     = DefaultThumbnailBytes;
 
     m_Archive = nullptr;
     m_ArchiveEntries.clear();
@@ -290,51 +514,266 @@ void ImageList::cancel_thumbnail_thread()
 {
     m_ThumbnailCancel->cancel();
 
-    m_ThreadPool.kill();
-    if (m_ThumbnailThread.joinable())
-        m_ThumbnailThread.join();
+    m_ThumbnailGroup.cancel();
+
+    {
+        // Cancelling the group drops the tasks that haven't started
+        std::scoped_lock lock{ m_ThumbnailMutex };
+        m_ThumbnailWorkers = 0;
+    }
 
+    m_ThumbnailFlushConn.disconnect();
     m_ThumbnailQueue.clear();
+    m_ThumbnailResults.clear();
 }
 
-// Returns an unsorted vector of the paths to valid T's.
 // T must have a static method ::is_valid_extension, ie Image and Archive
 template<typename T>
-std::vector<std::string> ImageList::get_entries(const std::string& path) const
+std::vector<std::string> ImageList::get_entries(const std::string& path)
 {
+    std::vector<std::string> entries;
+
+#ifdef _WIN32
     Glib::Dir dir(path);
-    std::vector<std::string> entries(dir.begin(), dir.end());
-    auto i = entries.begin();
 
-    while (i != entries.end())
+    for (const std::string& name : dir)
     {
-        // Make path absolute
-        *i = Glib::build_filename(path, *i);
-
         // Make sure it is a loadable image/archive
-        if (T::is_valid_extension(*i))
-            ++i;
-        else
-            i = entries.erase(i);
+        if (T::is_valid_extension(name))
+            entries.push_back(Glib::build_filename(path, name));
+    }
+#else  // !_WIN32
+    DIR* dir{ opendir(path.c_str()) };
+    if (!dir)
+        return entries;
+
+    while (dirent* e{ readdir(dir) })
+    {
+        // d_type lets directories be skipped without a stat call, filesystems that
+        // don't fill it in return DT_UNKNOWN and are treated like files
+        if (e->d_type != DT_REG && e->d_type != DT_LNK && e->d_type != DT_UNKNOWN)
+            continue;
+
+        // Make sure it is a loadable image/archive, only building the absolute
+        // path for the entries that are kept
+        if (T::is_valid_extension(e->d_name))
+            entries.push_back(Glib::build_filename(path, e->d_name));
     }
 
+    closedir(dir);
+#endif // !_WIN32
+
     return entries;
 }
 
+template std::vector<std::string> ImageList::get_entries<Image>(const std::string& path);
+template std::vector<std::string> ImageList::get_entries<Archive>(const std::string& path);
+
+// Runs in m_EntriesThread when a single image was opened
+void ImageList::load_entries(const std::string dir_path)
+{
+    std::vector<std::string> entries{ get_entries<Image>(dir_path) };
+    std::vector<NaturalSort::Key> keys;
+
+    if (m_EntriesCancel)
+        return;
+
+    NaturalSort::sort(entries, keys);
+
+    if (m_EntriesCancel)
+        return;
+
+    m_LoadedEntries = std::move(entries);
+    m_LoadedKeys    = std::move(keys);
+    m_SignalEntriesLoaded();
+}
+
+void ImageList::cancel_entries()
+{
+    m_EntriesCancel = true;
+    if (m_EntriesThread.joinable())
+        m_EntriesThread.join();
+    m_EntriesCancel = false;
+
+    m_MergeConn.disconnect();
+    m_LoadedEntries.clear();
+    m_LoadedKeys.clear();
+}
+
+void ImageList::on_entries_loaded()
+{
+    // This load was cancelled
+    if (!m_EntriesThread.joinable())
+        return;
+
+    m_EntriesThread.join();
+
+    // The entries before the opened image are inserted in front of it and the
+    // rest after it, the opened image itself is skipped
+    const std::string path{ m_Images[m_Index]->get_path() };
+    auto it{ std::find(m_LoadedEntries.begin(), m_LoadedEntries.end(), path) };
+    const bool found{ it != m_LoadedEntries.end() };
+
+    if (!found)
+        it = m_LoadedEntries.begin() +
+             (std::lower_bound(m_LoadedKeys.begin(), m_LoadedKeys.end(), m_SortKeys[m_Index]) -
+              m_LoadedKeys.begin());
+
+    m_MergeBefore = it - m_LoadedEntries.begin();
+    m_MergeAfter  = m_MergeBefore + (found ? 1 : 0);
+    m_MergeConn   = Glib::signal_idle().connect(sigc::mem_fun(*this, &ImageList::merge_entries));
+}
+
+// Adds up to MergeBatchSize entries on both sides of the images that are already in the list.
+// m_Index is adjusted so the current image doesn't change
+bool ImageList::merge_entries()
+{
+    auto create_image{ [&](const std::string& path) {
+        auto img{ std::make_shared<Image>(path) };
+        img->set_thumbnail_pack(m_ThumbnailPack);
+        return img;
+    } };
+
+    const size_t after_end{ std::min(m_MergeAfter + MergeBatchSize, m_LoadedEntries.size()) },
+        before_start{ m_MergeBefore > MergeBatchSize ? m_MergeBefore - MergeBatchSize : 0 };
+    const size_t n_after{ after_end - m_MergeAfter }, n_before{ m_MergeBefore - before_start };
+
+    if (n_after > 0)
+    {
+        {
+            std::scoped_lock lock{ m_ThumbnailMutex };
+            for (; m_MergeAfter < after_end; ++m_MergeAfter)
+                m_Images.push_back(create_image(m_LoadedEntries[m_MergeAfter]));
+        }
+
+        m_ThumbnailStates.resize(m_Images.size(), ThumbnailState::NONE);
+        m_SortKeys.insert(m_SortKeys.end(),
+                          std::make_move_iterator(m_LoadedKeys.begin() + (after_end - n_after)),
+                          std::make_move_iterator(m_LoadedKeys.begin() + after_end));
+        m_Widget->reserve(n_after);
+    }
+
+    if (n_before > 0)
+    {
+        std::vector<std::shared_ptr<Image>> images;
+        images.reserve(n_before);
+
+        for (size_t i = before_start; i < m_MergeBefore; ++i)
+            images.push_back(create_image(m_LoadedEntries[i]));
+
+        {
+            std::scoped_lock lock{ m_ThumbnailMutex };
+            m_Images.insert(m_Images.begin(), images.begin(), images.end());
+
+            // Requests that haven't been started would load the wrong images otherwise
+            for (auto& i : m_ThumbnailRequests)
+                i += n_before;
+
+            // Same for the results that haven't been passed to the widget yet
+            m_ThumbnailQueue.drain_into(m_ThumbnailResults);
+            for (auto& r : m_ThumbnailResults)
+                r.index += n_before;
+        }
+
+        m_ThumbnailStates.insert(m_ThumbnailStates.begin(), n_before, ThumbnailState::NONE);
+        m_SortKeys.insert(m_SortKeys.begin(),
+                          std::make_move_iterator(m_LoadedKeys.begin() + before_start),
+                          std::make_move_iterator(m_LoadedKeys.begin() + m_MergeBefore));
+        m_Index += n_before;
+        for (auto& i : m_Cache)
+            i += n_before;
+
+        for (size_t i = 0; i < n_before; ++i)
+            m_Widget->insert(0, Glib::RefPtr<Gdk::Pixbuf>{});
+
+        // Keep the current image in view
+        m_Widget->set_selected(m_Index);
+        m_MergeBefore = before_start;
+    }
+
+    update_cache();
+    update_thumbnails();
+    m_SignalSizeChanged();
+
+    if (m_MergeBefore == 0 && m_MergeAfter == m_LoadedEntries.size())
+    {
+        index_paths();
+        m_LoadedEntries.clear();
+        m_LoadedEntries.shrink_to_fit();
+        m_LoadedKeys.clear();
+        m_LoadedKeys.shrink_to_fit();
+        return false;
+    }
+
+    return true;
+}
+
 void ImageList::on_thumbnail_loaded()
 {
-    m_ThumbnailLoadedConn.block();
-    PixbufPair p;
+    if (!m_ThumbnailFlushConn)
+        m_ThumbnailFlushConn = Glib::signal_timeout().connect(
+            sigc::mem_fun(*this, &ImageList::flush_thumbnails), ThumbnailFlushInterval);
+}
+
+// Passes the loaded thumbnails to the widget in batches, stopping once the time budget
+// is used up so input and drawing are not starved when thousands of thumbnails are loaded
+bool ImageList::flush_thumbnails()
+{
+    const auto start{ std::chrono::steady_clock::now() };
+    std::vector<PixbufPair> batch;
 
-    while (m_ThumbnailCancel && !m_ThumbnailCancel->is_cancelled() && m_ThumbnailQueue.pop(p))
-        m_Widget->set_pixbuf(p.first, p.second);
+    batch.reserve(ThumbnailBatchSize);
+    m_ThumbnailQueue.drain_into(m_ThumbnailResults);
 
-    m_ThumbnailLoadedConn.unblock();
+    while (!m_ThumbnailCancel->is_cancelled() &&
+           std::chrono::steady_clock::now() - start <
+               std::chrono::milliseconds(ThumbnailFlushBudget))
+    {
+        for (; batch.size() < ThumbnailBatchSize && !m_ThumbnailResults.empty();
+             m_ThumbnailResults.pop_front())
+        {
+            ThumbnailResult& r{ m_ThumbnailResults.front() };
+            const size_t index{ r.index };
 
-    if (!m_ThreadPool.active())
+            // Indices are kept up to date by merge_entries and apply_directory_changes
+            if (index >= m_Images.size() || m_Images[index] != r.image)
+                continue;
+
+            if (index < m_ThumbnailStates.size() &&
+                m_ThumbnailStates[index] != ThumbnailState::LOADED)
+            {
+                m_ThumbnailStates[index] = ThumbnailState::LOADED;
+                ++m_ThumbnailsResident;
+            }
+
+            if (r.pixbuf)
+                m_ThumbnailBytes = std::max<size_t>(m_ThumbnailBytes, r.pixbuf->get_byte_length());
+
+            batch.emplace_back(index, std::move(r.pixbuf));
+        }
+
+        if (batch.empty())
+            break;
+
+        m_Widget->set_pixbufs(batch);
+        batch.clear();
+    }
+
+    if (m_ThumbnailCancel->is_cancelled())
+        return false;
+
+    // Keep the timeout running until the queue is drained
+    if (!m_ThumbnailResults.empty() || !m_ThumbnailQueue.empty())
+        return true;
+
+    if (!m_ThumbnailGroup.active())
         m_SignalThumbnailsLoaded();
+
+    return false;
 }
 
+// Changes are collected and applied together after FileChangeDelay ms, copying a
+// large number of files into the directory only updates the list a few times
 void ImageList::on_directory_changed(const Glib::RefPtr<Gio::File>& file,
                                      const Glib::RefPtr<Gio::File>&,
                                      Gio::FileMonitorEvent event)
@@ -342,73 +781,222 @@ void ImageList::on_directory_changed(const Glib::RefPtr<Gio::File>& file,
     if (!file)
         return;
 
-    ImageVector::iterator it;
-    auto comp = [&file](const std::shared_ptr<Image>& i) {
-        return i->get_path() == file->get_path();
-    };
+    const std::string path{ file->get_path() };
+
+    switch (event)
+    {
+    case Gio::FILE_MONITOR_EVENT_DELETED:
+        m_FileChanges[path] = FileChange::DELETED;
+        break;
+    case Gio::FILE_MONITOR_EVENT_CREATED:
+        m_FileChanges[path] = FileChange::CREATED;
+        break;
+    // The file has finished being written, it may have been created before it was valid
+    case Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        if (auto it{ m_FileChanges.find(path) };
+            it == m_FileChanges.end() || it->second != FileChange::CREATED)
+            m_FileChanges[path] = FileChange::CHANGED;
+        break;
+    default:
+        return;
+    }
+
+    if (!m_FileChangesConn)
+        m_FileChangesConn = Glib::signal_timeout().connect(
+            sigc::mem_fun(*this, &ImageList::apply_directory_changes), FileChangeDelay);
+}
+
+bool ImageList::apply_directory_changes()
+{
+    // Wait until the directory has been read, the changes may already be part of it
+    if (m_EntriesThread.joinable() || m_MergeConn)
+        return true;
+
+    if (m_Images.empty())
+    {
+        m_FileChanges.clear();
+        return false;
+    }
+
+    const std::string dir_path{ Glib::path_get_dirname(m_Images[m_Index]->get_path()) };
+    std::vector<bool> removed(m_Images.size(), false);
+    std::vector<std::string> added;
+    size_t n_removed{ 0 };
 
-    if (event == Gio::FILE_MONITOR_EVENT_DELETED)
+    for (const auto& [path, change] : m_FileChanges)
     {
-        if ((it = std::find_if(m_Images.begin(), m_Images.end(), comp)) != m_Images.end())
+        auto it{ m_PathIndices.find(path) };
+
+        if (change == FileChange::DELETED)
+        {
+            if (it != m_PathIndices.end())
+            {
+                removed[it->second] = true;
+                ++n_removed;
+            }
+            else if (path == dir_path)
+            {
+                m_FileChanges.clear();
+                clear();
+                return false;
+            }
+        }
+        // Only the extension is checked here, reading the file is left to the
+        // thumbnail and cache workers
+        else if (it == m_PathIndices.end())
+        {
+            if (Image::is_valid_extension(path))
+                added.push_back(path);
+        }
+        // The file was rewritten, load its thumbnail again
+        else if (change == FileChange::CHANGED && it->second < m_ThumbnailStates.size() &&
+                 m_ThumbnailStates[it->second] == ThumbnailState::LOADED)
         {
-            size_t index = it - m_Images.begin();
-            bool current = index == m_Index;
+            unload_thumbnail(it->second);
+        }
+    }
+
+    m_FileChanges.clear();
+
+    if (n_removed == 0 && added.empty())
+    {
+        update_thumbnails();
+        return false;
+    }
+
+    std::vector<NaturalSort::Key> added_keys;
+    NaturalSort::sort(added, added_keys);
+
+    // Where each new path goes in the current list, these are in ascending order
+    std::vector<size_t> positions;
+    positions.reserve(added.size());
+
+    for (const auto& key : added_keys)
+        positions.push_back(std::lower_bound(m_SortKeys.begin(), m_SortKeys.end(), key) -
+                            m_SortKeys.begin());
+
+    for (size_t i = m_Images.size(); i-- > 0;)
+        if (removed[i])
+            m_Widget->erase(i);
+
+    // Rebuild the image and thumbnail state vectors with the removed images left out and the
+    // new ones inserted
+    ImageVector images;
+    std::vector<ThumbnailState> states;
+    std::vector<NaturalSort::Key> keys;
+    std::vector<size_t> new_indices(m_Images.size(), std::numeric_limits<size_t>::max()),
+        inserted;
+    const bool current_removed{ removed[m_Index] };
+    size_t new_current{ 0 };
 
-            // Adjust m_Index if the deleted file was before it
-            if (index < m_Index)
-                --m_Index;
+    images.reserve(m_Images.size() - n_removed + added.size());
+    states.reserve(images.capacity());
+    keys.reserve(images.capacity());
 
-            m_Widget->erase(index);
-            m_Images.erase(it);
+    {
+        std::scoped_lock lock{ m_ThumbnailMutex };
 
-            if (current)
+        for (size_t i = 0, a = 0; i <= m_Images.size(); ++i)
+        {
+            for (; a < added.size() && positions[a] == i; ++a)
             {
-                if (m_Images.empty())
-                {
-                    clear();
-                    return;
-                }
-                else
-                {
-                    set_current(index == 0 ? 0 : index - 1, false, true);
-                }
+                auto img{ std::make_shared<Image>(added[a]) };
+                img->set_thumbnail_pack(m_ThumbnailPack);
+
+                inserted.push_back(images.size());
+                images.push_back(std::move(img));
+                states.push_back(ThumbnailState::NONE);
+                keys.push_back(std::move(added_keys[a]));
             }
-            else
+
+            if (i == m_Images.size())
+                break;
+
+            if (i == m_Index)
+                new_current = images.size();
+
+            const ThumbnailState state{ i < m_ThumbnailStates.size() ? m_ThumbnailStates[i]
+                                                                      : ThumbnailState::NONE };
+            if (removed[i])
             {
-                update_cache();
+                if (state == ThumbnailState::LOADED)
+                    --m_ThumbnailsResident;
+                continue;
             }
 
-            m_SignalSizeChanged();
+            new_indices[i] = images.size();
+            images.push_back(std::move(m_Images[i]));
+            states.push_back(state);
+            keys.push_back(std::move(m_SortKeys[i]));
         }
-        else if (file->get_path() == Glib::path_get_dirname(get_current()->get_path()))
+
+        m_Images = std::move(images);
+
+        // Requests that haven't been started follow their images, the removed ones are dropped
+        std::deque<size_t> requests;
+        for (const size_t i : m_ThumbnailRequests)
+            if (i < new_indices.size() && new_indices[i] != std::numeric_limits<size_t>::max())
+                requests.push_back(new_indices[i]);
+        m_ThumbnailsLoading -= m_ThumbnailRequests.size() - requests.size();
+        m_ThumbnailRequests = std::move(requests);
+
+        std::deque<ThumbnailResult> results;
+        m_ThumbnailQueue.drain_into(m_ThumbnailResults);
+        for (auto& r : m_ThumbnailResults)
         {
-            clear();
+            if (r.index < new_indices.size() &&
+                new_indices[r.index] != std::numeric_limits<size_t>::max())
+            {
+                r.index = new_indices[r.index];
+                results.push_back(std::move(r));
+            }
         }
+        m_ThumbnailResults = std::move(results);
     }
-    // The changed event is used in case the created event was too quick,
-    // and the file was invalid while still being written
-    else if ((event == Gio::FILE_MONITOR_EVENT_CREATED ||
-              event == Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT) &&
-             Image::is_valid(file->get_path()))
-    {
-        // Make sure the image wasn't already added
-        if (event == Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
-            std::find_if(m_Images.begin(), m_Images.end(), comp) != m_Images.end())
-            return;
 
-        std::shared_ptr<Image> img = std::make_shared<Image>(file->get_path());
-        it           = std::lower_bound(m_Images.begin(), m_Images.end(), img, NaturalSort());
-        size_t index = it - m_Images.begin();
+    m_ThumbnailStates = std::move(states);
+    m_SortKeys        = std::move(keys);
+
+    std::vector<size_t> cache;
+    for (const size_t i : m_Cache)
+        if (new_indices[i] != std::numeric_limits<size_t>::max())
+            cache.push_back(new_indices[i]);
+    m_Cache = std::move(cache);
+
+    for (const size_t i : inserted)
+        m_Widget->insert(i, Glib::RefPtr<Gdk::Pixbuf>{});
 
-        if (index <= m_Index)
-            ++m_Index;
+    index_paths();
 
-        m_Widget->insert(index, img->get_thumbnail(m_ThumbnailCancel));
-        m_Images.insert(it, img);
+    if (m_Images.empty())
+    {
+        clear();
+        return false;
+    }
 
+    if (current_removed)
+    {
+        set_current(new_current == 0 ? 0 : new_current - 1, false, true);
+    }
+    else
+    {
+        m_Index = new_current;
         update_cache();
-        m_SignalSizeChanged();
+        update_thumbnails();
     }
+
+    m_SignalSizeChanged();
+
+    return false;
+}
+
+void ImageList::index_paths()
+{
+    m_PathIndices.clear();
+    m_PathIndices.reserve(m_Images.size());
+
+    for (size_t i = 0; i < m_Images.size(); ++i)
+        m_PathIndices.emplace(m_Images[i]->get_path(), i);
 }
 
 void ImageList::set_current_relative(const int d)
@@ -432,15 +1020,94 @@ void ImageList::set_current_relative(const int d)
     }
 }
 
+void ImageList::update_nav_direction(const size_t index)
+{
+    int d{ 0 };
+    if (index == m_Index + 1)
+        d = 1;
+    else if (index + 1 == m_Index)
+        d = -1;
+
+    // Jumping around or changing directions starts over
+    if (d == 0 || (d > 0) != (m_NavDirection > 0))
+        m_NavDirection = d;
+    else
+        m_NavDirection = std::clamp(m_NavDirection + d, -NavDirectionMax, NavDirectionMax);
+}
+
+// Returns the indices that should be cached ordered by priority.
+// Normally this is CacheSize images on either side of m_Index, when the user has been
+// moving in one direction twice as many images are cached ahead and only a few behind
+std::vector<size_t> ImageList::get_cache_order() const
+{
+    const size_t cache_size{ static_cast<size_t>(Settings.get_int("CacheSize")) };
+    std::vector<size_t> cache;
+
+    if (std::abs(m_NavDirection) >= NavDirectionThreshold)
+    {
+        const bool forward{ m_NavDirection > 0 };
+        const size_t ahead{ cache_size * 2 }, behind{ (cache_size + 1) / 2 };
+        // Images behind are given the same priority as those this many times further ahead
+        const size_t behind_weight{ behind > 0 ? ahead / behind : 0 };
+        std::vector<std::pair<size_t, size_t>> weighted{ { 0, m_Index } };
+
+        for (size_t d = 1; d <= ahead; ++d)
+            if (forward ? m_Index + d < m_Images.size() : m_Index >= d)
+                weighted.emplace_back(d, forward ? m_Index + d : m_Index - d);
+
+        for (size_t d = 1; d <= behind; ++d)
+            if (forward ? m_Index >= d : m_Index + d < m_Images.size())
+                weighted.emplace_back(d * behind_weight, forward ? m_Index - d : m_Index + d);
+
+        std::stable_sort(weighted.begin(), weighted.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+
+        cache.reserve(weighted.size());
+        for (const auto& w : weighted)
+            cache.push_back(w.second);
+    }
+    else
+    {
+        // Only images within this range can be one of the closest cache_size * 2 + 1
+        const size_t first{ m_Index > cache_size * 2 ? m_Index - cache_size * 2 : 0 },
+            last{ std::min(m_Index + cache_size * 2 + 1, m_Images.size()) };
+        cache.resize(last - first);
+        std::iota(cache.begin(), cache.end(), first);
+
+        // Sort by distance from m_Index, images at the same distance are ordered by
+        // how recently they were viewed
+        std::sort(cache.begin(), cache.end(), [&](size_t a, size_t b) {
+            size_t adiff = std::abs(static_cast<int>(a - m_Index)),
+                   bdiff = std::abs(static_cast<int>(b - m_Index));
+            if (adiff == bdiff)
+            {
+                auto aaccess{ m_Images[a]->get_last_access() },
+                    baccess{ m_Images[b]->get_last_access() };
+                if (aaccess != baccess)
+                    return aaccess > baccess;
+            }
+            return m_IndexSort(a, b);
+        });
+
+        cache.resize(std::min(cache.size(), cache_size * 2 + 1));
+    }
+
+    return cache;
+}
+
 void ImageList::update_cache()
 {
-    cancel_cache();
+#ifndef NDEBUG
+    // Runs on every image change, so quickly moving through a directory of large images
+    // catches loads that are cancelled after publishing their pixbuf
+    check_cache_memory();
+#endif // !NDEBUG
 
-    std::vector<size_t> cache(m_Images.size()), diff;
-    std::iota(cache.begin(), cache.end(), 0);
-    std::sort(cache.begin(), cache.end(), m_IndexSort);
+    m_Images[m_Index]->update_last_access();
 
-    cache.resize(Settings.get_int("CacheSize") * 2 + 1);
+    std::vector<size_t> cache{ get_cache_order() }, diff;
+    limit_cache_memory(cache);
 
     // Get the indices of the images no longer in the cache
     if (!m_Cache.empty())
@@ -455,24 +1122,276 @@ void ImageList::update_cache()
 
     m_Cache = cache;
 
-    // Free images that are no longer in the cache
+    {
+        std::scoped_lock lock{ m_CacheMutex };
+
+        // Only abort the images that are no longer in the cache
+        for (auto& r : m_CacheLoading)
+        {
+            r.requeue = false;
+
+            if (std::find_if(m_Cache.begin(), m_Cache.end(), [&](const size_t i) {
+                    return m_Images[i] == r.image;
+                }) == m_Cache.end())
+                r.cancel->cancel();
+        }
+
+        // Rebuild the queue using the new priorities.  Images that are still being loaded
+        // are left alone, even cancelled ones so two workers never load the same image at
+        // once, those are queued again by their worker when the cancelled load finishes
+        m_CacheQueue.clear();
+
+        for (size_t i = 0; i < m_Cache.size(); ++i)
+        {
+            const auto& img{ m_Images[m_Cache[i]] };
+            auto it{ std::find_if(m_CacheLoading.begin(),
+                                  m_CacheLoading.end(),
+                                  [&img](const CacheRequest& r) { return r.image == img; }) };
+
+            if (it == m_CacheLoading.end())
+            {
+                m_CacheQueue.push_back({ i, img, {} });
+            }
+            else if (it->cancel->is_cancelled())
+            {
+                it->priority = i;
+                it->requeue  = true;
+            }
+        }
+
+        std::make_heap(m_CacheQueue.begin(), m_CacheQueue.end());
+        start_cache_workers();
+    }
+
+    // Free images that are no longer in the cache.  This is done after their loads were
+    // cancelled so a load can't publish a pixbuf after it was freed, like on_cache_loaded
     for (const auto i : diff)
         if (i <= m_Images.size() - 1)
             m_Images[i]->reset_pixbuf();
+}
 
-    m_CacheCancel->reset();
-    // Copy the imgaes into the queue and
-    // tell the cache thread it has some work
-    for (const auto i : m_Cache)
+void ImageList::cancel_cache()
+{
     {
-        m_CacheQueue.push(m_Images[i]);
-        m_CacheCond.notify_one();
+        std::scoped_lock lock{ m_CacheMutex };
+        m_CacheQueue.clear();
+
+        for (auto& r : m_CacheLoading)
+        {
+            r.cancel->cancel();
+            r.requeue = false;
+        }
     }
+
+    m_Cache.clear();
+    m_CacheLoadedQueue.clear();
 }
 
-void ImageList::cancel_cache()
+// Pushes cache workers until there is one for each queued image, must be called with
+// m_CacheMutex locked
+void ImageList::start_cache_workers()
 {
-    m_Cache.clear();
-    m_CacheQueue.clear();
-    m_CacheCancel->cancel();
+    // Decoding is mostly I/O and single threaded within gdk-pixbuf, a few workers are
+    // enough to keep one large image from blocking all of its neighbors
+    const size_t max_workers{ std::clamp<size_t>(Executor::get_instance().size() / 2, 1, 4) };
+
+    for (; m_CacheWorkers < std::min(max_workers, m_CacheQueue.size()); ++m_CacheWorkers)
+        m_CacheGroup.push([&]() { cache_worker(); });
+}
+
+// Each cache worker loads the highest priority image in m_CacheQueue until it is empty
+void ImageList::cache_worker()
+{
+    while (true)
+    {
+        CacheRequest req;
+        {
+            std::scoped_lock lock{ m_CacheMutex };
+
+            if (m_CacheQueue.empty())
+            {
+                --m_CacheWorkers;
+                return;
+            }
+
+            std::pop_heap(m_CacheQueue.begin(), m_CacheQueue.end());
+            req = std::move(m_CacheQueue.back());
+            m_CacheQueue.pop_back();
+
+            req.cancel = Gio::Cancellable::create();
+            m_CacheLoading.push_back(req);
+        }
+
+        DisplayArea area;
+        {
+            std::scoped_lock lock{ m_CacheMutex };
+            area = m_DisplayArea;
+        }
+
+        // Read here instead of in limit_cache_memory so the GTK thread never touches the file
+        req.image->estimate_memory_size();
+        req.image->set_decode_area(Settings.get_bool("DecodeAtScale") ? area : DisplayArea{});
+        req.image->load_pixbuf(req.cancel);
+
+        if (!req.cancel->is_cancelled() && area.valid())
+            req.image->create_scaled_pixbuf(area);
+
+        if (!req.cancel->is_cancelled())
+            req.image->create_mipmaps(req.cancel);
+
+        {
+            std::scoped_lock lock{ m_CacheMutex };
+            auto it{ std::find_if(
+                m_CacheLoading.begin(), m_CacheLoading.end(), [&req](const CacheRequest& r) {
+                    return r.cancel == req.cancel;
+                }) };
+
+            // The image came back into the cache while this cancelled load was running
+            if (it->requeue)
+            {
+                m_CacheQueue.push_back({ it->priority, req.image, {} });
+                std::push_heap(m_CacheQueue.begin(), m_CacheQueue.end());
+            }
+            // The load may have published its pixbuf before it saw the cancellation, and
+            // update_cache has already freed the image.  This is done before the request is
+            // removed from m_CacheLoading, otherwise update_cache could queue the image
+            // again and another worker load it before it is freed here
+            else if (req.cancel->is_cancelled())
+            {
+                req.image->reset_pixbuf();
+            }
+
+            m_CacheLoading.erase(it);
+        }
+
+        if (req.cancel->is_cancelled())
+        {
+            ++m_CacheWastedLoads;
+        }
+        else
+        {
+            m_CacheLoadedQueue.push(std::move(req.image));
+            m_SignalCacheLoaded();
+        }
+    }
+}
+
+// Removes indices from the end of cache (lowest priority) until the decoded size of
+// the remaining images fits into MaxCacheMemoryMB.  Images that have not been loaded yet
+// use their estimated size, or the size of the current image if a cache worker hasn't
+// estimated it yet.  The current image is always kept.
+void ImageList::limit_cache_memory(std::vector<size_t>& cache)
+{
+    const size_t max_bytes{ static_cast<size_t>(Settings.get_int("MaxCacheMemoryMB")) * 1024 *
+                            1024 };
+    if (max_bytes == 0)
+        return;
+
+    const auto& current{ m_Images[m_Index] };
+    size_t total{ 0 }, guess{ current->get_memory_size() };
+    auto it{ cache.begin() };
+
+    if (guess == 0)
+        guess = current->get_estimated_memory_size();
+
+    for (; it != cache.end(); ++it)
+    {
+        const auto& img{ m_Images[*it] };
+        size_t size{ img->get_memory_size() };
+
+        if (size == 0)
+            size = img->get_estimated_memory_size();
+        if (size == 0)
+            size = guess;
+
+        if (*it != m_Index && total + size > max_bytes)
+            break;
+
+        total += size;
+    }
+
+    cache.erase(it, cache.end());
+}
+
+#ifndef NDEBUG
+void ImageList::check_cache_memory()
+{
+    {
+        std::scoped_lock lock{ m_CacheMutex };
+        // Running loads and loads waiting for on_cache_loaded can still hold their pixbuf
+        if (!m_CacheLoading.empty() || !m_CacheLoadedQueue.empty())
+            return;
+    }
+
+    std::vector<bool> cached(m_Images.size(), false);
+    for (const size_t i : m_Cache)
+        if (i < cached.size())
+            cached[i] = true;
+
+    size_t leaked{ 0 };
+    for (size_t i = 0; i < m_Images.size(); ++i)
+        if (!cached[i])
+            leaked += m_Images[i]->get_memory_size();
+
+    if (leaked > 0)
+        std::cerr << "ImageList: " << leaked << " bytes are decoded outside of the cache"
+                  << std::endl;
+    assert(leaked == 0);
+}
+#endif // !NDEBUG
+
+// Estimated sizes can't be known for images that need to be extracted or downloaded first
+// so the budget is checked again once a cache worker has actually loaded them
+void ImageList::on_cache_loaded()
+{
+    bool check_budget{ false };
+
+    for (const auto& img : m_CacheLoadedQueue.pop_all())
+    {
+        // This image left the cache while it was being loaded
+        if (std::find_if(m_Cache.begin(), m_Cache.end(), [&](const size_t i) {
+                return m_Images[i] == img;
+            }) == m_Cache.end())
+        {
+            img->reset_pixbuf();
+            ++m_CacheWastedLoads;
+        }
+        else
+        {
+            check_budget = true;
+        }
+    }
+
+    if (!check_budget)
+        return;
+
+    auto cache{ m_Cache };
+    limit_cache_memory(cache);
+
+    if (cache.size() == m_Cache.size())
+        return;
+
+    {
+        std::scoped_lock lock{ m_CacheMutex };
+        m_CacheQueue.erase(std::remove_if(m_CacheQueue.begin(),
+                                          m_CacheQueue.end(),
+                                          [&](const CacheRequest& r) {
+                                              return r.priority >= cache.size();
+                                          }),
+                           m_CacheQueue.end());
+        std::make_heap(m_CacheQueue.begin(), m_CacheQueue.end());
+
+        for (const auto& r : m_CacheLoading)
+        {
+            if (std::find_if(m_Cache.begin() + cache.size(), m_Cache.end(), [&](const size_t i) {
+                    return m_Images[i] == r.image;
+                }) != m_Cache.end())
+                r.cancel->cancel();
+        }
+    }
+
+    for (size_t i = cache.size(); i < m_Cache.size(); ++i)
+        m_Images[m_Cache[i]]->reset_pixbuf();
+
+    m_Cache.resize(cache.size());
 }
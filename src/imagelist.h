@@ -1,14 +1,17 @@
 #pragma once
 
 #include "archive/archive.h"
+#include "executor.h"
 #include "image.h"
-#include "threadpool.h"
-#include "tsqueue.h"
+#include "mpscqueue.h"
+#include "naturalsort.h"
 #include "util.h"
 
+#include <deque>
 #include <gtkmm.h>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace AhoViewer
@@ -28,10 +31,10 @@ namespace AhoViewer
         // First argument is the number loaded, second is the total to load
         using SignalLoadProgressType = sigc::signal<void, size_t, size_t>;
 
+    public:
         // Used for async thumbnail pixbuf loading
         using PixbufPair = std::pair<size_t, Glib::RefPtr<Gdk::Pixbuf>>;
 
-    public:
         // ImageList::Widget {{{
         // This is used by ThumbnailBar and Booru::Page.
         class Widget
@@ -47,6 +50,11 @@ namespace AhoViewer
             {
                 return m_SignalSelectedChanged;
             }
+            // Emitted when the range returned by get_visible_range may have changed
+            sigc::signal<void> signal_visible_range_changed() const
+            {
+                return m_SignalVisibleRangeChanged;
+            }
             struct ModelColumns : public Gtk::TreeModel::ColumnRecord
             {
                 ModelColumns() { add(pixbuf); }
@@ -55,6 +63,9 @@ namespace AhoViewer
 
             virtual void set_selected(const size_t) = 0;
             virtual void scroll_to_selected()       = 0;
+            // Sets start and end to the first and last index that are at least partially
+            // visible, returns false if the widget isn't showing anything
+            virtual bool get_visible_range(size_t&, size_t&) const { return false; }
 
             virtual void clear()
             {
@@ -62,12 +73,20 @@ namespace AhoViewer
                 m_ListStore->clear();
                 m_CursorConn.unblock();
             }
-            virtual void set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
+            void set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
             {
                 Gtk::TreeIter it = m_ListStore->get_iter(std::to_string(index));
                 if (it)
                     it->set_value(0, pixbuf);
             }
+            // Called by ImageList at most once per frame with every thumbnail that finished
+            // loading since the last call.  Subclasses should do any relayout or scrolling
+            // once per batch here
+            virtual void set_pixbufs(const std::vector<PixbufPair>& pixbufs)
+            {
+                for (const auto& [index, pixbuf] : pixbufs)
+                    set_pixbuf(index, pixbuf);
+            }
             void reserve(const size_t s)
             {
                 for (size_t i = 0; i < s; ++i)
@@ -93,6 +112,7 @@ namespace AhoViewer
 
         protected:
             SignalSelectedChangedType m_SignalSelectedChanged;
+            sigc::signal<void> m_SignalVisibleRangeChanged;
             sigc::connection m_CursorConn;
         };
         // }}}
@@ -103,6 +123,11 @@ namespace AhoViewer
         virtual void clear();
         bool load(const std::string path, std::string& error, int index = 0);
 
+        // Returns an unsorted vector of the paths to valid T's in the directory path.
+        // Only instantiated for Image and Archive
+        template<typename T>
+        static std::vector<std::string> get_entries(const std::string& path);
+
         // Action callbacks {{{
         void go_next();
         void go_previous();
@@ -131,6 +156,15 @@ namespace AhoViewer
         ImageVector::iterator end() { return m_Images.end(); }
 
         void on_cache_size_changed();
+        // Cached images are scaled to fit this area by the cache workers
+        void set_display_area(const DisplayArea& area);
+        // Queues the current image on the cache workers again after it has requested
+        // its full size pixbuf or mipmaps
+        void reload_current();
+        void set_thumbnail_priority(const Executor::Priority priority)
+        {
+            m_ThumbnailGroup.set_priority(priority);
+        }
 
         SignalChangedType signal_changed() const { return m_SignalChanged; }
         SignalArchiveErrorType signal_archive_error() const { return m_SignalArchiveError; }
@@ -143,9 +177,18 @@ namespace AhoViewer
     protected:
         virtual void load_thumbnails();
         virtual void cancel_thumbnail_thread();
+        // Queues the missing thumbnails closest to the widget's visible range, thumbnails
+        // far away from it are unloaded once more than ThumbnailMaxBytes would be loaded.
+        // Requests that have not been started yet are reprioritized
+        void update_thumbnails();
         void update_cache();
 
         virtual void on_thumbnail_loaded();
+        bool flush_thumbnails();
+
+        // Keeps track of which way the user has been moving through the list
+        // must be called before m_Index is changed
+        void update_nav_direction(const size_t index);
 
         Widget* const m_Widget;
         ImageVector m_Images;
@@ -154,10 +197,28 @@ namespace AhoViewer
         ScrollPos m_ScrollPos;
 
         Glib::RefPtr<Gio::Cancellable> m_ThumbnailCancel;
-        std::thread m_ThumbnailThread;
-        ThreadPool m_ThreadPool;
-        TSQueue<PixbufPair> m_ThumbnailQueue;
+        // Thumbnail tasks on the shared executor
+        TaskGroup m_ThumbnailGroup{ Executor::Priority::THUMBNAIL };
+        // The index is fixed up by merge_entries and apply_directory_changes when images are
+        // inserted or removed before the thumbnail is passed to the widget
+        struct ThumbnailResult
+        {
+            size_t index;
+            std::shared_ptr<Image> image;
+            Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+        };
+        MPSCQueue<ThumbnailResult> m_ThumbnailQueue;
+        // Drained from m_ThumbnailQueue and waiting to be passed to the widget
+        std::deque<ThumbnailResult> m_ThumbnailResults;
+        // Loaded thumbnails are passed to the widget in batches of ThumbnailBatchSize every
+        // ThumbnailFlushInterval ms, until ThumbnailFlushBudget ms have been spent
+        static constexpr unsigned int ThumbnailFlushInterval{ 16 };
+        static constexpr int ThumbnailFlushBudget{ 8 };
+        static constexpr size_t ThumbnailBatchSize{ 32 };
+        sigc::connection m_ThumbnailFlushConn;
         std::atomic<size_t> m_ThumbnailsLoading{ 0 }, m_ThumbnailsLoaded{ 0 };
+        // Must be locked when m_Images is modified while thumbnails are loading
+        std::mutex m_ThumbnailMutex;
 
         SignalChangedType m_SignalChanged;
         SignalLoadProgressType m_SignalLoadProgress;
@@ -165,34 +226,135 @@ namespace AhoViewer
 
     private:
         void reset();
-        template<typename T>
-        std::vector<std::string> get_entries(const std::string& path) const;
 
         void on_directory_changed(const Glib::RefPtr<Gio::File>& file,
                                   const Glib::RefPtr<Gio::File>&,
                                   Gio::FileMonitorEvent event);
+        bool apply_directory_changes();
+        void index_paths();
 
         void set_current_relative(const int d);
+        void load_entries(const std::string dir_path);
+        void cancel_entries();
+        void on_entries_loaded();
+        bool merge_entries();
+        void push_thumbnail_worker();
+        bool pop_thumbnail_request(size_t& index,
+                                   std::shared_ptr<Image>& image,
+                                   const Executor::Priority priority);
+        void unload_thumbnail(const size_t index);
         void cancel_cache();
+        std::vector<size_t> get_cache_order() const;
+        void start_cache_workers();
+        void cache_worker();
+        void limit_cache_memory(std::vector<size_t>& cache);
+        void on_cache_loaded();
+#ifndef NDEBUG
+        // Asserts that no image outside of m_Cache holds decoded data while no cache loads
+        // are running, MaxCacheMemoryMB only accounts for the cached images
+        void check_cache_memory();
+#endif // !NDEBUG
+
+        // An image waiting to be loaded by one of the cache workers,
+        // lower priority values are loaded first.  cancel is created once a cache worker
+        // starts loading the image.  requeue is set when the image comes back into the cache
+        // while its cancelled load is still running, the worker queues it again once that
+        // load has finished
+        struct CacheRequest
+        {
+            size_t priority;
+            std::shared_ptr<Image> image;
+            Glib::RefPtr<Gio::Cancellable> cancel;
+            bool requeue{ false };
+
+            bool operator<(const CacheRequest& rhs) const { return priority > rhs.priority; }
+        };
+
+        // Number of consecutive steps taken in the same direction, negative when going
+        // backwards.  Once this reaches NavDirectionThreshold the cache favors images
+        // in that direction
+        int m_NavDirection{ 0 };
+        static constexpr int NavDirectionThreshold{ 2 }, NavDirectionMax{ 8 };
 
         // Indicies of the Images in the current cache
         std::vector<size_t> m_Cache;
-        // A queue of Images that need to be loaded
-        TSQueue<std::shared_ptr<Image>> m_CacheQueue;
+        // Heap of Images that need to be loaded, rebuilt by update_cache whenever
+        // m_Index changes.  Guarded by m_CacheMutex
+        std::vector<CacheRequest> m_CacheQueue;
+        // Images currently being loaded by the cache workers, guarded by m_CacheMutex
+        // Only these are cancelled when they leave the cache
+        std::vector<CacheRequest> m_CacheLoading;
+        // Number of loads that were cancelled or thrown away because the image left the
+        // cache before it finished loading
+        std::atomic<size_t> m_CacheWastedLoads{ 0 };
+        // Images that the cache workers have finished loading, checked against the
+        // memory budget in on_cache_loaded
+        MPSCQueue<std::shared_ptr<Image>> m_CacheLoadedQueue;
+        // Size and zoom the ImageBox is drawing with, guarded by m_CacheMutex
+        DisplayArea m_DisplayArea;
         std::unique_ptr<Archive> m_Archive;
         std::vector<std::string> m_ArchiveEntries;
         std::function<int(size_t, size_t)> m_IndexSort;
 
-        Glib::RefPtr<Gio::Cancellable> m_CacheCancel;
-        std::atomic<bool> m_CacheStop{ false };
-        std::condition_variable m_CacheCond;
-        std::mutex m_CacheMutex, m_ThumbnailMutex;
-        std::thread m_CacheThread;
+        enum class ThumbnailState : char
+        {
+            NONE,
+            QUEUED,
+            LOADED,
+        };
+        // One for each image, only used from the main thread
+        std::vector<ThumbnailState> m_ThumbnailStates;
+        size_t m_ThumbnailsResident{ 0 };
+        // Indices of the thumbnails waiting to be loaded, the most important first.
+        // The thread pool tasks pop from the front until it is empty
+        std::deque<size_t> m_ThumbnailRequests;
+        // Number of thread pool tasks that are popping m_ThumbnailRequests, both are
+        // guarded by m_ThumbnailMutex
+        size_t m_ThumbnailWorkers{ 0 };
+        static constexpr size_t ThumbnailMaxBytes{ 128 * 1024 * 1024 },
+            DefaultThumbnailBytes{ Image::ThumbnailSize * Image::ThumbnailSize * 4 };
+        // Size of the largest thumbnail that has been loaded, booru thumbnails are bigger
+        // than local ones.  At most ThumbnailMaxBytes / m_ThumbnailBytes are kept loaded
+        size_t m_ThumbnailBytes{ DefaultThumbnailBytes };
+
+        std::mutex m_CacheMutex;
+        // Number of executor tasks popping m_CacheQueue, guarded by m_CacheMutex
+        size_t m_CacheWorkers{ 0 };
+        TaskGroup m_CacheGroup{ Executor::Priority::INTERACTIVE };
         Glib::RefPtr<Gio::FileMonitor> m_FileMonitor;
 
-        Glib::Dispatcher m_SignalThumbnailLoaded;
-
-        sigc::connection m_ThumbnailLoadedConn;
+        enum class FileChange
+        {
+            CREATED,
+            CHANGED,
+            DELETED,
+        };
+        // The latest change to each path since the changes were last applied
+        std::unordered_map<std::string, FileChange> m_FileChanges;
+        // Index of each image in m_Images, only kept for local directories
+        std::unordered_map<std::string, size_t> m_PathIndices;
+        // Natural sort key of each image in m_Images, only kept for local directories so
+        // new files can be placed without creating a key for every path they're compared to
+        std::vector<NaturalSort::Key> m_SortKeys;
+        static constexpr unsigned int FileChangeDelay{ 100 };
+        // Only used for local directories when the ThumbnailPack setting is enabled
+        std::shared_ptr<ThumbnailPack> m_ThumbnailPack;
+
+        // Reads and sorts the directory when a single image was opened, the sorted
+        // entries are then merged into m_Images MergeBatchSize at a time on each side
+        std::thread m_EntriesThread;
+        std::atomic<bool> m_EntriesCancel{ false };
+        std::vector<std::string> m_LoadedEntries;
+        std::vector<NaturalSort::Key> m_LoadedKeys;
+        // Entries in m_LoadedEntries before m_MergeBefore and from m_MergeAfter on
+        // have not been merged yet
+        size_t m_MergeBefore{ 0 }, m_MergeAfter{ 0 };
+        static constexpr size_t MergeBatchSize{ 512 };
+
+        Glib::Dispatcher m_SignalThumbnailLoaded, m_SignalCacheLoaded, m_SignalEntriesLoaded;
+
+        sigc::connection m_ThumbnailLoadedConn, m_CacheLoadedConn, m_DisplayAreaConn,
+            m_VisibleRangeConn, m_EntriesLoadedConn, m_MergeConn, m_FileChangesConn;
 
         SignalArchiveErrorType m_SignalArchiveError;
         sigc::signal<void> m_SignalLoadSuccess, m_SignalSizeChanged, m_SignalThumbnailsLoaded;
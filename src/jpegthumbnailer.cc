@@ -0,0 +1,311 @@
+#include "config.h"
+
+#ifdef HAVE_LIBJPEG
+#include "jpegthumbnailer.h"
+using namespace AhoViewer;
+
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <glib/gstdio.h>
+// jpeglib.h expects FILE and size_t to already be declared
+#include <jpeglib.h>
+
+struct ErrorManager
+{
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+// Lives in the caller's frame so nothing in it is left indeterminate by longjmp
+struct Decoder
+{
+    jpeg_decompress_struct cinfo;
+    ErrorManager err;
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+};
+
+[[noreturn]] static void on_error(j_common_ptr cinfo)
+{
+    longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+}
+
+// Warnings about corrupt data, the image is usually still fine
+static void on_message(j_common_ptr) { }
+
+static uint32_t read_u16(const uint8_t* p, const bool le)
+{
+    return le ? p[0] | p[1] << 8 : p[0] << 8 | p[1];
+}
+
+static uint32_t read_u32(const uint8_t* p, const bool le)
+{
+    return le ? read_u16(p, le) | read_u16(p + 2, le) << 16
+              : read_u16(p, le) << 16 | read_u16(p + 2, le);
+}
+
+// Finds the JPEG stored in IFD1 of an APP1 EXIF segment
+static bool find_exif_thumbnail(const uint8_t* data,
+                                size_t len,
+                                const uint8_t*& thumb,
+                                size_t& thumb_len)
+{
+    if (len < 14 || std::memcmp(data, "Exif\0\0", 6) != 0)
+        return false;
+
+    // Offsets are from the start of the TIFF header
+    const uint8_t* tiff{ data + 6 };
+    len -= 6;
+
+    bool le;
+    if (tiff[0] == 'I' && tiff[1] == 'I')
+        le = true;
+    else if (tiff[0] == 'M' && tiff[1] == 'M')
+        le = false;
+    else
+        return false;
+
+    if (read_u16(tiff + 2, le) != 42)
+        return false;
+
+    const size_t ifd0{ read_u32(tiff + 4, le) };
+    if (ifd0 > len - 2)
+        return false;
+
+    const size_t next{ ifd0 + 2 + read_u16(tiff + ifd0, le) * 12 };
+    if (next > len - 4)
+        return false;
+
+    const size_t ifd1{ read_u32(tiff + next, le) };
+    if (ifd1 == 0 || ifd1 > len - 2)
+        return false;
+
+    const size_t n_entries{ read_u16(tiff + ifd1, le) };
+    if (ifd1 + 2 + n_entries * 12 > len)
+        return false;
+
+    size_t offset{ 0 }, length{ 0 };
+    for (size_t i = 0; i < n_entries; ++i)
+    {
+        const uint8_t* entry{ tiff + ifd1 + 2 + i * 12 };
+        const uint32_t tag{ read_u16(entry, le) };
+
+        // JPEGInterchangeFormat and JPEGInterchangeFormatLength
+        if (tag == 0x0201)
+            offset = read_u32(entry + 8, le);
+        else if (tag == 0x0202)
+            length = read_u32(entry + 8, le);
+    }
+
+    if (offset == 0 || length == 0 || offset > len || length > len - offset)
+        return false;
+
+    thumb     = tiff + offset;
+    thumb_len = length;
+
+    return true;
+}
+
+// Walks the segments before the image data for the image's size and its EXIF thumbnail
+static bool parse_headers(const uint8_t* data,
+                          const size_t len,
+                          int& width,
+                          int& height,
+                          const uint8_t*& thumb,
+                          size_t& thumb_len)
+{
+    if (len < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+
+    for (size_t pos = 2; pos + 4 <= len;)
+    {
+        if (data[pos] != 0xFF)
+            return false;
+
+        const uint8_t marker{ data[pos + 1] };
+        // Fill bytes
+        if (marker == 0xFF)
+        {
+            ++pos;
+            continue;
+        }
+
+        const size_t seg_len{ read_u16(data + pos + 2, false) };
+        if (seg_len < 2 || seg_len > len - pos - 2)
+            return false;
+
+        const uint8_t* payload{ data + pos + 4 };
+
+        if (marker == 0xE1 && !thumb)
+        {
+            find_exif_thumbnail(payload, seg_len - 2, thumb, thumb_len);
+        }
+        // Any start of frame, 0xC4, 0xC8 and 0xCC are other segments in the same range
+        else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+                 marker != 0xCC)
+        {
+            if (seg_len < 7)
+                return false;
+
+            height = static_cast<int>(read_u16(payload + 1, false));
+            width  = static_cast<int>(read_u16(payload + 3, false));
+
+            return width > 0 && height > 0;
+        }
+        // Start of scan, the frame header should have come before this
+        else if (marker == 0xDA)
+        {
+            return false;
+        }
+
+        pos += 2 + seg_len;
+    }
+
+    return false;
+}
+
+// Everything that can longjmp happens in here, d is owned by the caller
+static bool decode_scaled(Decoder& d,
+                          const uint8_t* data,
+                          const size_t len,
+                          const int w,
+                          const int h,
+                          const Glib::RefPtr<Gio::Cancellable>& c)
+{
+    if (setjmp(d.err.jump))
+        return false;
+
+    jpeg_create_decompress(&d.cinfo);
+    jpeg_mem_src(&d.cinfo, data, len);
+    jpeg_read_header(&d.cinfo, TRUE);
+
+    // libjpeg can't convert these to RGB, gdk-pixbuf can
+    if (d.cinfo.jpeg_color_space == JCS_CMYK || d.cinfo.jpeg_color_space == JCS_YCCK)
+        return false;
+
+    // The largest reduction that is still at least w x h
+    unsigned int denom{ 8 };
+    while (denom > 1 && (d.cinfo.image_width / denom < static_cast<unsigned int>(w) ||
+                         d.cinfo.image_height / denom < static_cast<unsigned int>(h)))
+        denom /= 2;
+
+    d.cinfo.out_color_space = JCS_RGB;
+    d.cinfo.scale_num       = 1;
+    d.cinfo.scale_denom     = denom;
+    d.cinfo.dct_method      = JDCT_IFAST;
+
+    jpeg_start_decompress(&d.cinfo);
+
+    d.pixbuf = Gdk::Pixbuf::create(
+        Gdk::COLORSPACE_RGB, false, 8, d.cinfo.output_width, d.cinfo.output_height);
+    if (!d.pixbuf)
+        return false;
+
+    uint8_t* pixels{ d.pixbuf->get_pixels() };
+    const int stride{ d.pixbuf->get_rowstride() };
+
+    while (d.cinfo.output_scanline < d.cinfo.output_height)
+    {
+        if (c && c->is_cancelled())
+            return false;
+
+        JSAMPROW rows[8];
+        const JDIMENSION n{ std::min<JDIMENSION>(
+            8, d.cinfo.output_height - d.cinfo.output_scanline) };
+
+        for (JDIMENSION i = 0; i < n; ++i)
+            rows[i] = pixels + static_cast<size_t>(d.cinfo.output_scanline + i) * stride;
+
+        jpeg_read_scanlines(&d.cinfo, rows, n);
+    }
+
+    jpeg_finish_decompress(&d.cinfo);
+
+    return true;
+}
+
+bool JpegThumbnailer::is_jpeg(const std::string& path)
+{
+    FILE* f{ g_fopen(path.c_str(), "rb") };
+    if (!f)
+        return false;
+
+    uint8_t magic[3];
+    const bool ret{ fread(magic, sizeof(magic), 1, f) == 1 && magic[0] == 0xFF &&
+                    magic[1] == 0xD8 && magic[2] == 0xFF };
+    fclose(f);
+
+    return ret;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> JpegThumbnailer::create(const std::string& path,
+                                                  const int w,
+                                                  const int h,
+                                                  const Glib::RefPtr<Gio::Cancellable>& c)
+{
+    GMappedFile* mapped{ g_mapped_file_new(path.c_str(), FALSE, nullptr) };
+    if (!mapped)
+        return {};
+
+    const auto* data{ reinterpret_cast<const uint8_t*>(g_mapped_file_get_contents(mapped)) };
+    const size_t len{ g_mapped_file_get_length(mapped) };
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+    int width{ 0 }, height{ 0 };
+    const uint8_t* thumb{ nullptr };
+    size_t thumb_len{ 0 };
+
+    if (data && parse_headers(data, len, width, height, thumb, thumb_len))
+    {
+        // The same size gdk-pixbuf scales to when keeping the aspect ratio
+        const double r{ std::min(static_cast<double>(w) / width,
+                                 static_cast<double>(h) / height) };
+        const int sw{ std::max(static_cast<int>(std::lround(width * r)), 1) },
+            sh{ std::max(static_cast<int>(std::lround(height * r)), 1) };
+
+        if (thumb)
+        {
+            pixbuf = decode(thumb, thumb_len, sw, sh, c);
+
+            // Small or letterboxed EXIF thumbnails would look worse than decoding the image
+            if (pixbuf &&
+                (pixbuf->get_width() < sw || pixbuf->get_height() < sh ||
+                 std::abs(static_cast<double>(pixbuf->get_width()) / pixbuf->get_height() -
+                          static_cast<double>(width) / height) >
+                     0.02 * width / height))
+                pixbuf.reset();
+        }
+
+        if (!pixbuf && !(c && c->is_cancelled()))
+            pixbuf = decode(data, len, sw, sh, c);
+
+        if (pixbuf && (pixbuf->get_width() != sw || pixbuf->get_height() != sh))
+            pixbuf = Resampler::scale(pixbuf, sw, sh, Resampler::Filter::LANCZOS);
+    }
+
+    g_mapped_file_unref(mapped);
+
+    return pixbuf;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> JpegThumbnailer::decode(const uint8_t* data,
+                                                  const size_t len,
+                                                  const int w,
+                                                  const int h,
+                                                  const Glib::RefPtr<Gio::Cancellable>& c)
+{
+    Decoder d{};
+    d.cinfo.err              = jpeg_std_error(&d.err.pub);
+    d.err.pub.error_exit     = on_error;
+    d.err.pub.output_message = on_message;
+
+    const bool ok{ decode_scaled(d, data, len, w, h, c) };
+    // Also aborts an unfinished decompression
+    jpeg_destroy_decompress(&d.cinfo);
+
+    return ok ? d.pixbuf : Glib::RefPtr<Gdk::Pixbuf>{};
+}
+#endif // HAVE_LIBJPEG
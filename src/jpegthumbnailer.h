@@ -0,0 +1,32 @@
+#pragma once
+
+#include <gdkmm.h>
+#include <giomm.h>
+#include <string>
+
+namespace AhoViewer
+{
+    // Creates thumbnails of JPEG files without decoding them at full size.  The EXIF
+    // thumbnail is used when it is at least as big as the thumbnail and has the same aspect
+    // ratio as the image, otherwise libjpeg decodes the image at 1/2, 1/4 or 1/8 of its size
+    // (whichever is still at least as big as the thumbnail) and the result is scaled to fit
+    class JpegThumbnailer
+    {
+    public:
+        // Returns the image scaled to fit in w x h keeping its aspect ratio, or a null
+        // RefPtr if path isn't a JPEG that libjpeg can decode to RGB
+        static Glib::RefPtr<Gdk::Pixbuf> create(const std::string& path,
+                                                const int w,
+                                                const int h,
+                                                const Glib::RefPtr<Gio::Cancellable>& c);
+        // Checks the first bytes of the file for the JPEG SOI marker
+        static bool is_jpeg(const std::string& path);
+
+    private:
+        static Glib::RefPtr<Gdk::Pixbuf> decode(const uint8_t* data,
+                                                const size_t len,
+                                                const int w,
+                                                const int h,
+                                                const Glib::RefPtr<Gio::Cancellable>& c);
+    };
+}
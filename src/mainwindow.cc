@@ -88,6 +88,14 @@ MainWindow::MainWindow(BaseObjectType* cobj, const Glib::RefPtr<Gtk::Builder>& b
     m_ImageBox->signal_image_drawn().connect(sigc::mem_fun(*this, &MainWindow::update_title));
     m_ImageBox->signal_slideshow_ended().connect(
         sigc::bind(sigc::mem_fun(*this, &MainWindow::on_toggle_slideshow), false));
+    m_ImageBox->signal_display_area_changed().connect([&](const DisplayArea& area) {
+        if (m_ActiveImageList)
+            m_ActiveImageList->set_display_area(area);
+    });
+    m_ImageBox->signal_reload_requested().connect([&]() {
+        if (m_ActiveImageList)
+            m_ActiveImageList->reload_current();
+    });
 
     auto prefs{ Application::get_default()->get_preferences_dialog() };
     prefs->signal_bg_color_set().connect(
@@ -97,6 +105,8 @@ MainWindow::MainWindow(BaseObjectType* cobj, const Glib::RefPtr<Gtk::Builder>& b
         sigc::mem_fun(m_ImageBox, &ImageBox::cursor_timeout));
     prefs->signal_cache_size_changed().connect(
         sigc::mem_fun(*this, &MainWindow::on_cache_size_changed));
+    prefs->signal_max_cache_memory_changed().connect(
+        sigc::mem_fun(*this, &MainWindow::on_cache_size_changed));
     prefs->signal_slideshow_delay_changed().connect(
         sigc::mem_fun(m_ImageBox, &ImageBox::reset_slideshow));
     prefs->get_site_editor()->signal_edited().connect(
@@ -420,6 +430,7 @@ void MainWindow::set_active_imagelist(const std::shared_ptr<ImageList>& image_li
     m_ImageListConn.disconnect();
     m_ImageListClearedConn.disconnect();
     m_ActiveImageList = image_list;
+    m_ActiveImageList->set_display_area(m_ImageBox->get_display_area());
 
     m_ImageListConn = m_ActiveImageList->signal_changed().connect(
         sigc::mem_fun(*this, &MainWindow::on_imagelist_changed));
@@ -758,10 +769,30 @@ void MainWindow::on_imagelist_changed(const std::shared_ptr<Image>& image)
     m_StatusBar->set_page_info(m_ActiveImageList->get_index() + 1, m_ActiveImageList->get_size());
     m_StatusBar->set_filename(image->get_filename());
 
+    m_ImageLoadProgConn.disconnect();
+    // The dispatcher belongs to the image, so the connection can't outlive it
+    m_ImageLoadProgConn = image->signal_load_progress().connect(
+        sigc::bind(sigc::mem_fun(*this, &MainWindow::on_image_load_progress), image.get()));
+
     m_ImageBox->set_image(image);
     set_sensitives();
 }
 
+void MainWindow::on_image_load_progress(const Image* image)
+{
+    size_t c, t;
+    image->get_load_progress(c, t);
+
+    if (t == 0)
+        return;
+
+    m_StatusBar->set_progress(
+        Glib::ustring::compose(_("Loading %1 / %2"), Glib::format_size(c), Glib::format_size(t)),
+        static_cast<double>(c) / t,
+        StatusBar::Priority::DOWNLOAD,
+        c == t ? 2 : 0);
+}
+
 void MainWindow::on_imagelist_cleared()
 {
     if (m_LocalImageList == m_ActiveImageList)
@@ -61,6 +61,7 @@ namespace AhoViewer
 
         void on_imagelist_changed(const std::shared_ptr<Image>& image);
         void on_imagelist_cleared();
+        void on_image_load_progress(const Image* image);
         void on_cache_size_changed();
 
         // Action callbacks {{{
@@ -118,6 +119,6 @@ namespace AhoViewer
         std::chrono::time_point<std::chrono::steady_clock> m_LastSizeAllocateTime;
 
         std::shared_ptr<ImageList> m_ActiveImageList, m_LocalImageList;
-        sigc::connection m_ImageListConn, m_ImageListClearedConn;
+        sigc::connection m_ImageListConn, m_ImageListClearedConn, m_ImageLoadProgConn;
     };
 }
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace AhoViewer
+{
+    // A lock-free queue for any number of producer threads and a single consumer thread.
+    // Producers push onto an atomic list, the consumer takes the whole list at once and
+    // reverses it back into the order it was pushed in, so there is no lock or per-element
+    // contention between them.  Only the consumer may call drain_into, pop_all and clear.
+    // Every push allocates a node, so this is no faster than a mutex and std::queue when there
+    // is little contention (see bench/mpscqueue.cc), what it avoids is the consumer (usually
+    // the GTK thread) waiting on a lock held by a producer
+    template<typename T>
+    class MPSCQueue
+    {
+    public:
+        MPSCQueue() = default;
+        ~MPSCQueue() { clear(); }
+        MPSCQueue(const MPSCQueue&) = delete;
+        MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+        void push(const T& v) { push_node(new Node{ v, nullptr }); }
+        void push(T&& v) { push_node(new Node{ std::move(v), nullptr }); }
+        template<typename... Args>
+        void emplace(Args&&... v)
+        {
+            push_node(new Node{ T{ std::forward<Args>(v)... }, nullptr });
+        }
+
+        // Appends everything that has been pushed to out, oldest first.  Returns the number
+        // of elements that were appended
+        template<typename Container>
+        size_t drain_into(Container& out)
+        {
+            size_t n{ 0 };
+
+            for (Node* node{ take_all() }; node; ++n)
+            {
+                out.push_back(std::move(node->value));
+                delete std::exchange(node, node->next);
+            }
+
+            return n;
+        }
+        std::vector<T> pop_all()
+        {
+            std::vector<T> v;
+            drain_into(v);
+            return v;
+        }
+        void clear()
+        {
+            for (Node* node{ take_all() }; node;)
+                delete std::exchange(node, node->next);
+        }
+        bool empty() const { return m_Head.load(std::memory_order_acquire) == nullptr; }
+
+    private:
+        struct Node
+        {
+            T value;
+            Node* next;
+        };
+
+        void push_node(Node* node)
+        {
+            node->next = m_Head.load(std::memory_order_relaxed);
+            while (!m_Head.compare_exchange_weak(
+                node->next, node, std::memory_order_release, std::memory_order_relaxed))
+                ;
+        }
+
+        // Takes the whole list, which is newest first, and reverses it
+        Node* take_all()
+        {
+            Node *node{ m_Head.exchange(nullptr, std::memory_order_acquire) }, *prev{ nullptr };
+
+            while (node)
+            {
+                Node* next{ node->next };
+                node->next = prev;
+                prev       = std::exchange(node, next);
+            }
+
+            return prev;
+        }
+
+        std::atomic<Node*> m_Head{ nullptr };
+    };
+}
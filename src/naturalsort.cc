@@ -0,0 +1,139 @@
+#include "naturalsort.h"
+using namespace AhoViewer;
+
+#include "executor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+
+NaturalSort::Key::Key(const std::string& s)
+{
+    m_Text.reserve(s.size());
+
+    for (size_t i = 0; i < s.size();)
+    {
+        if (std::isdigit(static_cast<unsigned char>(s[i])))
+        {
+            unsigned long n{ 0 };
+
+            // Saturate instead of overflowing, like strtoul
+            for (; i < s.size() && std::isdigit(static_cast<unsigned char>(s[i])); ++i)
+            {
+                const unsigned long d = s[i] - '0';
+                n = n > (ULONG_MAX - d) / 10 ? ULONG_MAX : n * 10 + d;
+            }
+
+            m_Tokens.push_back({ n, 0, 0 });
+        }
+        else
+        {
+            const auto offset{ static_cast<uint32_t>(m_Text.size()) };
+
+            for (; i < s.size() && !std::isdigit(static_cast<unsigned char>(s[i])); ++i)
+                m_Text.push_back(std::tolower(static_cast<unsigned char>(s[i])));
+
+            m_Tokens.push_back({ 0, offset, static_cast<uint32_t>(m_Text.size()) - offset });
+        }
+    }
+}
+
+bool NaturalSort::Key::operator<(const Key& rhs) const
+{
+    for (size_t i = 0; i < m_Tokens.size() && i < rhs.m_Tokens.size(); ++i)
+    {
+        const Token &a{ m_Tokens[i] }, &b{ rhs.m_Tokens[i] };
+        const bool a_num{ a.length == 0 }, b_num{ b.length == 0 };
+
+        if (a_num && b_num)
+        {
+            if (a.number != b.number)
+                return a.number < b.number;
+            continue;
+        }
+
+        // Numbers come before text
+        if (a_num || b_num)
+            return a_num;
+
+        const size_t n{ std::min(a.length, b.length) };
+        const int r{ m_Text.compare(a.offset, n, rhs.m_Text, b.offset, n) };
+
+        if (r != 0)
+            return r < 0;
+        if (a.length == b.length)
+            continue;
+
+        // One text run starts with the other, the shorter one comes first when it is
+        // followed by a number and last when it's the end of the string
+        if (a.length < b.length)
+            return i + 1 < m_Tokens.size();
+        return i + 1 >= rhs.m_Tokens.size();
+    }
+
+    // Whichever has anything left comes first
+    return m_Tokens.size() > rhs.m_Tokens.size();
+}
+
+void NaturalSort::sort(std::vector<std::string>& paths)
+{
+    std::vector<Key> keys;
+    sort(paths, keys);
+}
+
+void NaturalSort::sort(std::vector<std::string>& paths, std::vector<Key>& keys)
+{
+    using Entry = std::pair<Key, std::string>;
+
+    std::vector<Entry> entries(paths.size());
+    auto less{ [](const Entry& a, const Entry& b) { return a.first < b.first; } };
+    auto sort_range{ [&](const size_t first, const size_t last) {
+        for (size_t i = first; i < last; ++i)
+            entries[i] = { Key(paths[i]), std::move(paths[i]) };
+
+        std::sort(entries.begin() + first, entries.begin() + last, less);
+    } };
+
+    const size_t n_chunks{ std::clamp<size_t>(Executor::get_instance().size(), 1, 8) };
+
+    if (paths.size() < ParallelSortThreshold || n_chunks == 1)
+    {
+        sort_range(0, paths.size());
+    }
+    else
+    {
+        // The user is waiting for the list to open
+        TaskGroup group{ Executor::Priority::INTERACTIVE };
+        std::vector<size_t> bounds;
+
+        for (size_t i = 0; i <= n_chunks; ++i)
+            bounds.push_back(paths.size() * i / n_chunks);
+
+        for (size_t i = 0; i < n_chunks; ++i)
+            group.push([&, i]() { sort_range(bounds[i], bounds[i + 1]); });
+        group.wait();
+
+        // Merge neighbouring chunks in pairs until only one is left
+        for (size_t width = 1; width < n_chunks; width *= 2)
+        {
+            for (size_t i = 0; i + width < n_chunks; i += width * 2)
+            {
+                group.push([&, i, width]() {
+                    std::inplace_merge(entries.begin() + bounds[i],
+                                       entries.begin() + bounds[i + width],
+                                       entries.begin() + bounds[std::min(i + width * 2, n_chunks)],
+                                       less);
+                });
+            }
+
+            group.wait();
+        }
+    }
+
+    keys.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        paths[i] = std::move(entries[i].second);
+        keys[i]  = std::move(entries[i].first);
+    }
+}
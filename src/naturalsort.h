@@ -2,62 +2,56 @@
 
 #include "image.h"
 
-#include <cctype>
-#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace AhoViewer
 {
+    // Orders strings so that runs of digits are compared by their value and everything
+    // else case insensitively, e.g. image2.png comes before image10.png
     class NaturalSort
     {
     public:
-        bool operator()(const std::string& a, const std::string& b)
+        // A string split once into its number and lowercased text runs, comparing two keys
+        // doesn't need to parse the strings again
+        class Key
         {
-            return compare_natural(a.c_str(), b.c_str());
-        }
-        bool operator()(const std::shared_ptr<Image>& a, const std::shared_ptr<Image>& b)
-        {
-            return compare_natural(a->get_path().c_str(), b->get_path().c_str());
-        }
+        public:
+            Key() = default;
+            explicit Key(const std::string& s);
 
-    private:
-        bool compare_natural(const char* a, const char* b)
-        {
-            // End of string
-            if (!a || !b)
-                return !!a;
+            bool operator<(const Key& rhs) const;
 
-            // Both are numbers, compare them as such
-            if (std::isdigit(*a) && std::isdigit(*b))
+        private:
+            // Text runs are never empty, so a length of 0 means the token is a number
+            struct Token
             {
-                char *a_after, *b_after;
-                unsigned long a_l = strtoul(a, &a_after, 10), b_l = strtoul(b, &b_after, 10);
+                unsigned long number;
+                uint32_t offset, length;
+            };
 
-                if (a_l != b_l)
-                    return a_l < b_l;
+            // Every text run lowercased and concatenated
+            std::string m_Text;
+            std::vector<Token> m_Tokens;
+        };
 
-                return compare_natural(a_after, b_after);
-            }
-
-            // One of them is a number
-            if (std::isdigit(*a) || std::isdigit(*b))
-                return std::isdigit(*a);
-
-            // Both of them are not numbers
-            while (*a && *b)
-            {
-                // Both letters were the same, are they numbers?
-                if (std::isdigit(*a) || std::isdigit(*b))
-                    return compare_natural(a, b);
-
-                // Both are letters but different letters
-                if (std::tolower(*a) != std::tolower(*b))
-                    return std::tolower(*a) < std::tolower(*b);
+        bool operator()(const std::string& a, const std::string& b) const
+        {
+            return Key(a) < Key(b);
+        }
+        bool operator()(const std::shared_ptr<Image>& a, const std::shared_ptr<Image>& b) const
+        {
+            return Key(a->get_path()) < Key(b->get_path());
+        }
 
-                ++a;
-                ++b;
-            }
+        // Sorts paths by creating each one's key once, large vectors are sorted in
+        // chunks on the executor that are then merged
+        static void sort(std::vector<std::string>& paths);
+        // Same as above, keys is set to the key of each sorted path so later lookups
+        // don't have to create them again
+        static void sort(std::vector<std::string>& paths, std::vector<Key>& keys);
 
-            return !!*a;
-        }
+        static constexpr size_t ParallelSortThreshold{ 8192 };
     };
 }
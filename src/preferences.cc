@@ -10,6 +10,7 @@ PreferencesDialog::PreferencesDialog(BaseObjectType* cobj, const Glib::RefPtr<Gt
       m_SpinSignals({
           { "CursorHideDelay", sigc::signal<void>() },
           { "CacheSize", sigc::signal<void>() },
+          { "MaxCacheMemoryMB", sigc::signal<void>() },
           { "SlideshowDelay", sigc::signal<void>() },
       })
 {
@@ -71,6 +72,7 @@ PreferencesDialog::PreferencesDialog(BaseObjectType* cobj, const Glib::RefPtr<Gt
         "StartFullscreen", "HideAllFullscreen", "RememberWindowSize",   "RememberWindowPos",
         "SmartNavigation", "AutoOpenArchive",   "RememberLastFile",     "StoreRecentFiles",
         "SaveThumbnails",  "AskDeleteConfirm",  "RememberLastSavePath", "SaveImageTags",
+        "DecodeAtScale",   "ThumbnailPack",
     };
 
     for (const std::string& s : check_settings)
@@ -86,6 +88,7 @@ PreferencesDialog::PreferencesDialog(BaseObjectType* cobj, const Glib::RefPtr<Gt
     std::vector<std::string> spin_settings = {
         "CursorHideDelay",
         "CacheSize",
+        "MaxCacheMemoryMB",
         "SlideshowDelay",
         "BooruLimit",
     };
@@ -28,6 +28,10 @@ namespace AhoViewer
         {
             return m_SpinSignals.at("CacheSize");
         }
+        sigc::signal<void> signal_max_cache_memory_changed() const
+        {
+            return m_SpinSignals.at("MaxCacheMemoryMB");
+        }
         sigc::signal<void> signal_slideshow_delay_changed() const
         {
             return m_SpinSignals.at("SlideshowDelay");
@@ -0,0 +1,680 @@
+#include "resample.h"
+using namespace AhoViewer;
+
+#include "executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESAMPLE_X86
+#include <immintrin.h>
+#endif // __GNUC__ && (__x86_64__ || __i386__)
+
+using Plane  = Resampler::Plane;
+using Filter = Resampler::Filter;
+
+// Filter weights are fixed point with this many fractional bits, few enough that every
+// weight fits in an int16_t for the SIMD kernels
+static constexpr int PrecisionBits{ 14 };
+
+enum class Isa
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+static Isa get_isa()
+{
+    static const Isa isa{ []() {
+#ifdef RESAMPLE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return Isa::AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return Isa::SSE2;
+#endif // RESAMPLE_X86
+        return Isa::SCALAR;
+    }() };
+
+    return isa;
+}
+
+// The source pixels that contribute to each destination pixel along one axis
+struct Coefficients
+{
+    // The most taps any destination pixel has
+    int window;
+    std::vector<int> first, count;
+    // window weights for each destination pixel
+    std::vector<int16_t> weights;
+};
+
+static double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+
+    x *= M_PI;
+    return std::sin(x) / x;
+}
+
+static double filter_weight(const Filter filter, const double x)
+{
+    switch (filter)
+    {
+    case Filter::LANCZOS:
+        return std::abs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    case Filter::BILINEAR:
+    default:
+        return std::max(1.0 - std::abs(x), 0.0);
+    }
+}
+
+static Coefficients get_coefficients(const int in_size, const int out_size, const Filter filter)
+{
+    const double scale{ static_cast<double>(in_size) / out_size },
+        // Stretch the filter when reducing so every source pixel is covered
+        filter_scale{ std::max(scale, 1.0) },
+        support{ (filter == Filter::LANCZOS ? 3.0 : 1.0) * filter_scale };
+    Coefficients c;
+
+    c.window = static_cast<int>(std::ceil(support)) * 2 + 1;
+    c.first.resize(out_size);
+    c.count.resize(out_size);
+    c.weights.assign(static_cast<size_t>(out_size) * c.window, 0);
+
+    std::vector<double> weights(c.window);
+
+    for (int i = 0; i < out_size; ++i)
+    {
+        const double center{ (i + 0.5) * scale };
+        const int first{ std::clamp(static_cast<int>(center - support + 0.5), 0, in_size - 1) },
+            last{ std::min(static_cast<int>(center + support + 0.5), in_size) },
+            n{ std::clamp(last - first, 1, c.window) };
+        double total{ 0.0 };
+
+        for (int k = 0; k < n; ++k)
+            total += weights[k] = filter_weight(filter, (first + k - center + 0.5) / filter_scale);
+
+        if (total == 0.0)
+        {
+            weights[0] = total = 1.0;
+            std::fill(weights.begin() + 1, weights.begin() + n, 0.0);
+        }
+
+        int16_t* w{ &c.weights[static_cast<size_t>(i) * c.window] };
+        int fixed_total{ 0 }, largest{ 0 };
+
+        for (int k = 0; k < n; ++k)
+        {
+            w[k] = static_cast<int16_t>(std::lround(weights[k] / total * (1 << PrecisionBits)));
+            fixed_total += w[k];
+            if (w[k] > w[largest])
+                largest = k;
+        }
+
+        // Make the weights add up to exactly 1 so flat areas keep their value
+        w[largest] += (1 << PrecisionBits) - fixed_total;
+
+        c.first[i] = first;
+        c.count[i] = n;
+    }
+
+    return c;
+}
+
+static uint8_t clamp_pixel(const int v)
+{
+    return static_cast<uint8_t>(std::clamp(v, 0, 255));
+}
+
+// Averages blocks of src into the rows [y0, y1) of dest, where dest is no larger than src.
+// The blocks are spread over the whole image so no edge pixels are dropped, and colors are
+// weighted by alpha so fully transparent pixels don't bleed into the average
+static void box_rows(const Plane& src,
+                     const Plane& dest,
+                     const int n_channels,
+                     const std::vector<int>& x_bounds,
+                     const int y0,
+                     const int y1)
+{
+    std::vector<uint64_t> sums(static_cast<size_t>(dest.width) * n_channels);
+
+    for (int y = y0; y < y1; ++y)
+    {
+        const int sy0{ static_cast<int>(static_cast<int64_t>(y) * src.height / dest.height) },
+            sy1{ static_cast<int>(static_cast<int64_t>(y + 1) * src.height / dest.height) };
+
+        std::fill(sums.begin(), sums.end(), 0);
+
+        for (int sy = sy0; sy < sy1; ++sy)
+        {
+            const uint8_t* in{ src.pixels + static_cast<size_t>(sy) * src.stride };
+
+            for (int x = 0; x < dest.width; ++x)
+            {
+                uint64_t* s{ &sums[static_cast<size_t>(x) * n_channels] };
+                const uint8_t* p{ in + static_cast<size_t>(x_bounds[x]) * n_channels };
+
+                for (int sx = x_bounds[x]; sx < x_bounds[x + 1]; ++sx, p += n_channels)
+                {
+                    if (n_channels == 4)
+                    {
+                        s[0] += p[0] * p[3];
+                        s[1] += p[1] * p[3];
+                        s[2] += p[2] * p[3];
+                        s[3] += p[3];
+                    }
+                    else
+                    {
+                        s[0] += p[0];
+                        s[1] += p[1];
+                        s[2] += p[2];
+                    }
+                }
+            }
+        }
+
+        uint8_t* out{ dest.pixels + static_cast<size_t>(y) * dest.stride };
+
+        for (int x = 0; x < dest.width; ++x)
+        {
+            const uint64_t* s{ &sums[static_cast<size_t>(x) * n_channels] };
+            const uint64_t count{ static_cast<uint64_t>(sy1 - sy0) *
+                                  (x_bounds[x + 1] - x_bounds[x]) };
+            uint8_t* o{ out + static_cast<size_t>(x) * n_channels };
+
+            if (n_channels == 4)
+            {
+                const uint64_t alpha{ s[3] };
+
+                for (int ch = 0; ch < 3; ++ch)
+                    o[ch] = alpha ? static_cast<uint8_t>((s[ch] + alpha / 2) / alpha) : 0;
+                o[3] = static_cast<uint8_t>((alpha + count / 2) / count);
+            }
+            else
+            {
+                for (int ch = 0; ch < 3; ++ch)
+                    o[ch] = static_cast<uint8_t>((s[ch] + count / 2) / count);
+            }
+        }
+    }
+}
+
+static void horizontal_rows_scalar(const Plane& src,
+                                   const Plane& dest,
+                                   const int n_channels,
+                                   const Coefficients& c,
+                                   const int y0,
+                                   const int y1)
+{
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t* in{ src.pixels + static_cast<size_t>(y) * src.stride };
+        uint8_t* out{ dest.pixels + static_cast<size_t>(y) * dest.stride };
+
+        for (int x = 0; x < dest.width; ++x)
+        {
+            const int16_t* w{ &c.weights[static_cast<size_t>(x) * c.window] };
+            const uint8_t* p{ in + static_cast<size_t>(c.first[x]) * n_channels };
+
+            for (int ch = 0; ch < n_channels; ++ch)
+            {
+                int sum{ 1 << (PrecisionBits - 1) };
+
+                for (int k = 0; k < c.count[x]; ++k)
+                    sum += p[k * n_channels + ch] * w[k];
+
+                out[x * n_channels + ch] = clamp_pixel(sum >> PrecisionBits);
+            }
+        }
+    }
+}
+
+// Computes the bytes [x0, x1) of one destination row from the source rows starting at first
+static void vertical_span_scalar(const Plane& src,
+                                 uint8_t* out,
+                                 const int x0,
+                                 const int x1,
+                                 const int16_t* w,
+                                 const int first,
+                                 const int n)
+{
+    for (int x = x0; x < x1; ++x)
+    {
+        int sum{ 1 << (PrecisionBits - 1) };
+
+        for (int k = 0; k < n; ++k)
+            sum += src.pixels[static_cast<size_t>(first + k) * src.stride + x] * w[k];
+
+        out[x] = clamp_pixel(sum >> PrecisionBits);
+    }
+}
+
+static void vertical_rows_scalar(const Plane& src,
+                                 const Plane& dest,
+                                 const int n_channels,
+                                 const Coefficients& c,
+                                 const int y0,
+                                 const int y1)
+{
+    for (int y = y0; y < y1; ++y)
+        vertical_span_scalar(src,
+                             dest.pixels + static_cast<size_t>(y) * dest.stride,
+                             0,
+                             dest.width * n_channels,
+                             &c.weights[static_cast<size_t>(y) * c.window],
+                             c.first[y],
+                             c.count[y]);
+}
+
+#ifdef RESAMPLE_X86
+// Two weights packed for _mm_madd_epi16, which multiplies pairs of 16 bit values
+static int32_t weight_pair(const int16_t a, const int16_t b)
+{
+    return static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(b)) << 16) |
+                                static_cast<uint16_t>(a));
+}
+
+__attribute__((target("sse2"))) static __m128i load_pixel(const uint8_t* p, const int n_channels)
+{
+    uint32_t v{ 0 };
+    std::memcpy(&v, p, n_channels);
+    return _mm_cvtsi32_si128(static_cast<int>(v));
+}
+
+// Each destination pixel's channels are computed together, two source pixels at a time
+__attribute__((target("sse2"))) static void horizontal_rows_sse2(const Plane& src,
+                                                                 const Plane& dest,
+                                                                 const int n_channels,
+                                                                 const Coefficients& c,
+                                                                 const int y0,
+                                                                 const int y1)
+{
+    const __m128i zero{ _mm_setzero_si128() }, round{ _mm_set1_epi32(1 << (PrecisionBits - 1)) };
+
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t* in{ src.pixels + static_cast<size_t>(y) * src.stride };
+        uint8_t* out{ dest.pixels + static_cast<size_t>(y) * dest.stride };
+
+        for (int x = 0; x < dest.width; ++x)
+        {
+            const int16_t* w{ &c.weights[static_cast<size_t>(x) * c.window] };
+            const uint8_t* p{ in + static_cast<size_t>(c.first[x]) * n_channels };
+            const int n{ c.count[x] };
+            __m128i sum{ round };
+            int k{ 0 };
+
+            for (; k + 1 < n; k += 2)
+            {
+                // r0 r1 g0 g1 b0 b1 a0 a1 as 16 bit values
+                const __m128i px{ _mm_unpacklo_epi8(
+                    _mm_unpacklo_epi8(load_pixel(p + k * n_channels, n_channels),
+                                      load_pixel(p + (k + 1) * n_channels, n_channels)),
+                    zero) };
+                const __m128i wk{ _mm_set1_epi32(weight_pair(w[k], w[k + 1])) };
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(px, wk));
+            }
+
+            if (k < n)
+            {
+                const __m128i px{ _mm_unpacklo_epi8(
+                    _mm_unpacklo_epi8(load_pixel(p + k * n_channels, n_channels), zero), zero) };
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(px, _mm_set1_epi32(weight_pair(w[k], 0))));
+            }
+
+            sum = _mm_srai_epi32(sum, PrecisionBits);
+            sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), zero);
+
+            const auto v{ static_cast<uint32_t>(_mm_cvtsi128_si32(sum)) };
+            std::memcpy(out + static_cast<size_t>(x) * n_channels, &v, n_channels);
+        }
+    }
+}
+
+// 16 bytes of a destination row are computed at a time, two source rows at a time
+__attribute__((target("sse2"))) static void vertical_rows_sse2(const Plane& src,
+                                                               const Plane& dest,
+                                                               const int n_channels,
+                                                               const Coefficients& c,
+                                                               const int y0,
+                                                               const int y1)
+{
+    const __m128i zero{ _mm_setzero_si128() }, round{ _mm_set1_epi32(1 << (PrecisionBits - 1)) };
+    const int row_bytes{ dest.width * n_channels };
+
+    for (int y = y0; y < y1; ++y)
+    {
+        const int16_t* w{ &c.weights[static_cast<size_t>(y) * c.window] };
+        const int first{ c.first[y] }, n{ c.count[y] };
+        uint8_t* out{ dest.pixels + static_cast<size_t>(y) * dest.stride };
+        int x{ 0 };
+
+        for (; x + 16 <= row_bytes; x += 16)
+        {
+            __m128i s0{ round }, s1{ round }, s2{ round }, s3{ round };
+
+            for (int k = 0; k < n; k += 2)
+            {
+                const uint8_t* row{ src.pixels + static_cast<size_t>(first + k) * src.stride + x };
+                const __m128i a{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(row)) },
+                    b{ k + 1 < n
+                           ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + src.stride))
+                           : zero },
+                    wk{ _mm_set1_epi32(weight_pair(w[k], k + 1 < n ? w[k + 1] : 0)) },
+                    lo{ _mm_unpacklo_epi8(a, b) }, hi{ _mm_unpackhi_epi8(a, b) };
+
+                s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wk));
+                s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wk));
+                s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wk));
+                s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wk));
+            }
+
+            const __m128i p01{ _mm_packs_epi32(_mm_srai_epi32(s0, PrecisionBits),
+                                               _mm_srai_epi32(s1, PrecisionBits)) },
+                p23{ _mm_packs_epi32(_mm_srai_epi32(s2, PrecisionBits),
+                                     _mm_srai_epi32(s3, PrecisionBits)) };
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(p01, p23));
+        }
+
+        vertical_span_scalar(src, out, x, row_bytes, w, first, n);
+    }
+}
+
+// Same as vertical_rows_sse2 with 32 bytes at a time.  The unpacks and packs both work
+// within each 128 bit lane so the bytes end up back in order
+__attribute__((target("avx2"))) static void vertical_rows_avx2(const Plane& src,
+                                                               const Plane& dest,
+                                                               const int n_channels,
+                                                               const Coefficients& c,
+                                                               const int y0,
+                                                               const int y1)
+{
+    const __m256i zero{ _mm256_setzero_si256() },
+        round{ _mm256_set1_epi32(1 << (PrecisionBits - 1)) };
+    const int row_bytes{ dest.width * n_channels };
+
+    for (int y = y0; y < y1; ++y)
+    {
+        const int16_t* w{ &c.weights[static_cast<size_t>(y) * c.window] };
+        const int first{ c.first[y] }, n{ c.count[y] };
+        uint8_t* out{ dest.pixels + static_cast<size_t>(y) * dest.stride };
+        int x{ 0 };
+
+        for (; x + 32 <= row_bytes; x += 32)
+        {
+            __m256i s0{ round }, s1{ round }, s2{ round }, s3{ round };
+
+            for (int k = 0; k < n; k += 2)
+            {
+                const uint8_t* row{ src.pixels + static_cast<size_t>(first + k) * src.stride + x };
+                const __m256i a{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row)) },
+                    b{ k + 1 < n
+                           ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + src.stride))
+                           : zero },
+                    wk{ _mm256_set1_epi32(weight_pair(w[k], k + 1 < n ? w[k + 1] : 0)) },
+                    lo{ _mm256_unpacklo_epi8(a, b) }, hi{ _mm256_unpackhi_epi8(a, b) };
+
+                s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), wk));
+                s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), wk));
+                s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), wk));
+                s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), wk));
+            }
+
+            const __m256i p01{ _mm256_packs_epi32(_mm256_srai_epi32(s0, PrecisionBits),
+                                                  _mm256_srai_epi32(s1, PrecisionBits)) },
+                p23{ _mm256_packs_epi32(_mm256_srai_epi32(s2, PrecisionBits),
+                                        _mm256_srai_epi32(s3, PrecisionBits)) };
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x),
+                                _mm256_packus_epi16(p01, p23));
+        }
+
+        vertical_span_scalar(src, out, x, row_bytes, w, first, n);
+    }
+}
+#endif // RESAMPLE_X86
+
+// Runs func over the rows [0, n) split into bands on the shared executor.  The calling
+// thread takes bands as well, so it never ends up waiting on workers that are busy with
+// other tasks before they have started
+static void
+parallel_rows(const int n, const size_t row_cost, const std::function<void(int, int)>& func)
+{
+    const size_t n_workers{ Executor::get_instance().size() };
+
+    if (n < 2 || n_workers == 0 || static_cast<size_t>(n) * row_cost < Resampler::ParallelMinCost)
+    {
+        func(0, n);
+        return;
+    }
+
+    const int n_bands{ std::min(n, static_cast<int>(n_workers + 1) * 2) };
+    std::atomic<int> next{ 0 };
+    auto run{ [&]() {
+        for (int b; (b = next++) < n_bands;)
+            func(static_cast<int64_t>(b) * n / n_bands, static_cast<int64_t>(b + 1) * n / n_bands);
+    } };
+
+    TaskGroup group{ Executor::Priority::INTERACTIVE };
+    for (size_t i = 0; i < std::min(n_workers, static_cast<size_t>(n_bands - 1)); ++i)
+        group.push(run);
+
+    run();
+    // Helpers that never started have nothing left to do, only wait for the running ones
+    group.cancel();
+}
+
+static void copy_rows(const Plane& src, const Plane& dest, const int n_channels)
+{
+    for (int y = 0; y < dest.height; ++y)
+        std::memcpy(dest.pixels + static_cast<size_t>(y) * dest.stride,
+                    src.pixels + static_cast<size_t>(y) * src.stride,
+                    static_cast<size_t>(dest.width) * n_channels);
+}
+
+// Multiplies the colors of the RGBA rows [y0, y1) of src by their alpha into dest, which
+// can be src itself.  The separable filters work on premultiplied colors so fully
+// transparent pixels don't bleed into their neighbours, like box_rows' alpha weighting
+static void premultiply_rows(const Plane& src, const Plane& dest, const int y0, const int y1)
+{
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t* in{ src.pixels + static_cast<size_t>(y) * src.stride };
+        uint8_t* out{ dest.pixels + static_cast<size_t>(y) * dest.stride };
+
+        for (int x = 0; x < dest.width; ++x, in += 4, out += 4)
+        {
+            const int a{ in[3] };
+
+            for (int ch = 0; ch < 3; ++ch)
+                out[ch] = static_cast<uint8_t>((in[ch] * a + 127) / 255);
+            out[3] = static_cast<uint8_t>(a);
+        }
+    }
+}
+
+// Ringing can leave a color larger than its alpha, it's clamped to white
+static void unpremultiply_rows(const Plane& plane, const int y0, const int y1)
+{
+    for (int y = y0; y < y1; ++y)
+    {
+        uint8_t* p{ plane.pixels + static_cast<size_t>(y) * plane.stride };
+
+        for (int x = 0; x < plane.width; ++x, p += 4)
+        {
+            const int a{ p[3] };
+
+            if (a == 255)
+                continue;
+
+            for (int ch = 0; ch < 3; ++ch)
+                p[ch] = a ? clamp_pixel((p[ch] * 255 + a / 2) / a) : 0;
+        }
+    }
+}
+
+Glib::RefPtr<Gdk::Pixbuf> Resampler::scale(const Glib::RefPtr<Gdk::Pixbuf>& src,
+                                           const int w,
+                                           const int h,
+                                           const Filter filter)
+{
+    auto dest{ Gdk::Pixbuf::create(
+        Gdk::COLORSPACE_RGB, src->get_has_alpha(), 8, std::max(w, 1), std::max(h, 1)) };
+
+    if (dest)
+        scale(src, dest, filter);
+
+    return dest;
+}
+
+void Resampler::scale(const Glib::RefPtr<Gdk::Pixbuf>& src,
+                      const Glib::RefPtr<Gdk::Pixbuf>& dest,
+                      const Filter filter)
+{
+    const int n_channels{ src->get_n_channels() };
+
+    if (src->get_bits_per_sample() != 8 || n_channels != dest->get_n_channels() ||
+        (n_channels != 3 && n_channels != 4))
+    {
+        src->scale(dest,
+                   0,
+                   0,
+                   dest->get_width(),
+                   dest->get_height(),
+                   0,
+                   0,
+                   static_cast<double>(dest->get_width()) / src->get_width(),
+                   static_cast<double>(dest->get_height()) / src->get_height(),
+                   filter == Filter::LANCZOS ? Gdk::INTERP_HYPER : Gdk::INTERP_BILINEAR);
+        return;
+    }
+
+    scale({ src->get_pixels(), src->get_width(), src->get_height(), src->get_rowstride() },
+          { dest->get_pixels(), dest->get_width(), dest->get_height(), dest->get_rowstride() },
+          n_channels,
+          filter);
+}
+
+void Resampler::scale(const Plane& src,
+                      const Plane& dest,
+                      const int n_channels,
+                      const Filter filter)
+{
+    if (src.width == dest.width && src.height == dest.height)
+    {
+        copy_rows(src, dest, n_channels);
+        return;
+    }
+
+    const Isa isa{ get_isa() };
+    Plane in{ src };
+    std::vector<uint8_t> reduced, premultiplied, horizontal;
+
+    // Box filter large reductions down to less than twice the destination size
+    const int fx{ src.width / dest.width }, fy{ src.height / dest.height };
+    if (fx >= 2 || fy >= 2)
+    {
+        Plane box{ nullptr,
+                   fx >= 2 ? src.width / fx : src.width,
+                   fy >= 2 ? src.height / fy : src.height,
+                   0 };
+
+        if (box.width == dest.width && box.height == dest.height)
+        {
+            box = dest;
+        }
+        else
+        {
+            box.stride = box.width * n_channels;
+            reduced.resize(static_cast<size_t>(box.stride) * box.height);
+            box.pixels = reduced.data();
+        }
+
+        std::vector<int> x_bounds(box.width + 1);
+        for (int x = 0; x <= box.width; ++x)
+            x_bounds[x] = static_cast<int64_t>(x) * src.width / box.width;
+
+        parallel_rows(box.height,
+                      static_cast<size_t>(src.width) * n_channels * std::max(fy, 1),
+                      [&](const int y0, const int y1) {
+                          box_rows(src, box, n_channels, x_bounds, y0, y1);
+                      });
+
+        if (box.pixels == dest.pixels)
+            return;
+
+        in = box;
+    }
+
+    if (n_channels == 4)
+    {
+        // The box filter's output is already a copy and is premultiplied in place
+        Plane out{ in };
+
+        if (reduced.empty())
+        {
+            out.stride = in.width * 4;
+            premultiplied.resize(static_cast<size_t>(out.stride) * out.height);
+            out.pixels = premultiplied.data();
+        }
+
+        parallel_rows(in.height,
+                      static_cast<size_t>(in.width) * 4,
+                      [&](const int y0, const int y1) { premultiply_rows(in, out, y0, y1); });
+        in = out;
+    }
+
+    Plane tmp{ in };
+
+    if (in.width != dest.width)
+    {
+        const Coefficients c{ get_coefficients(in.width, dest.width, filter) };
+
+        tmp = { nullptr, dest.width, in.height, dest.width * n_channels };
+        horizontal.resize(static_cast<size_t>(tmp.stride) * tmp.height);
+        tmp.pixels = horizontal.data();
+
+        parallel_rows(tmp.height,
+                      static_cast<size_t>(tmp.stride) * c.window,
+                      [&](const int y0, const int y1) {
+#ifdef RESAMPLE_X86
+                          if (isa != Isa::SCALAR)
+                              return horizontal_rows_sse2(in, tmp, n_channels, c, y0, y1);
+#endif // RESAMPLE_X86
+                          horizontal_rows_scalar(in, tmp, n_channels, c, y0, y1);
+                      });
+    }
+
+    if (tmp.height == dest.height)
+    {
+        copy_rows(tmp, dest, n_channels);
+    }
+    else
+    {
+        const Coefficients c{ get_coefficients(tmp.height, dest.height, filter) };
+
+        parallel_rows(dest.height,
+                      static_cast<size_t>(dest.width) * n_channels * c.window,
+                      [&](const int y0, const int y1) {
+#ifdef RESAMPLE_X86
+                          if (isa == Isa::AVX2)
+                              return vertical_rows_avx2(tmp, dest, n_channels, c, y0, y1);
+                          if (isa == Isa::SSE2)
+                              return vertical_rows_sse2(tmp, dest, n_channels, c, y0, y1);
+#endif // RESAMPLE_X86
+                          vertical_rows_scalar(tmp, dest, n_channels, c, y0, y1);
+                      });
+    }
+
+    if (n_channels == 4)
+        parallel_rows(dest.height,
+                      static_cast<size_t>(dest.width) * 4,
+                      [&](const int y0, const int y1) { unpremultiply_rows(dest, y0, y1); });
+}
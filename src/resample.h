@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <gdkmm.h>
+
+namespace AhoViewer
+{
+    // Scales 8 bit RGB and RGBA pixbufs, used instead of Gdk::Pixbuf::scale_simple.
+    //
+    // Reductions of 2x or more are first box filtered down to less than twice the
+    // destination size, averaging every source pixel (weighted by alpha) so large
+    // reductions don't alias.  The rest is done with a separable bilinear or Lanczos filter,
+    // on premultiplied colors for RGBA.
+    // Large images are split into bands of rows that are scaled on the shared executor, and
+    // SSE2 or AVX2 kernels are picked at runtime when the CPU supports them
+    class Resampler
+    {
+    public:
+        enum class Filter
+        {
+            BILINEAR,
+            // Sharper, used for thumbnails
+            LANCZOS,
+        };
+
+        // Pixel data that isn't owned by a pixbuf, rows are stride bytes apart
+        struct Plane
+        {
+            uint8_t* pixels;
+            int width, height, stride;
+        };
+
+        static Glib::RefPtr<Gdk::Pixbuf>
+        scale(const Glib::RefPtr<Gdk::Pixbuf>& src, const int w, const int h, const Filter filter);
+        // Scales src to fill dest, both must have the same number of channels
+        static void scale(const Glib::RefPtr<Gdk::Pixbuf>& src,
+                          const Glib::RefPtr<Gdk::Pixbuf>& dest,
+                          const Filter filter);
+        static void
+        scale(const Plane& src, const Plane& dest, const int n_channels, const Filter filter);
+
+        // Rows * taps * bytes per row below which scaling isn't split into bands
+        static constexpr size_t ParallelMinCost{ 1024 * 1024 };
+    };
+}
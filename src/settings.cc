@@ -29,9 +29,11 @@ SettingsManager::SettingsManager()
                        { "HideAll", false },           { "HideAllFullscreen", true },
                        { "RememberWindowSize", true }, { "RememberWindowPos", true },
                        { "ShowTagTypeHeaders", true }, { "AutoHideInfoBox", true },
-                       { "AskDeleteConfirm", true },   { "Mute", false } }),
+                       { "AskDeleteConfirm", true },   { "Mute", false },
+                       { "DecodeAtScale", true },      { "ThumbnailPack", true } }),
       m_DefaultInts({ { "ArchiveIndex", -1 },
                       { "CacheSize", 2 },
+                      { "MaxCacheMemoryMB", 1024 },
                       { "SlideshowDelay", 5 },
                       { "CursorHideDelay", 2 },
                       { "TagViewPosition", -1 },
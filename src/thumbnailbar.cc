@@ -21,6 +21,13 @@ ThumbnailBar::ThumbnailBar(BaseObjectType* cobj, const Glib::RefPtr<Gtk::Builder
     m_TreeView->set_model(m_ListStore);
     m_TreeView->append_column("Thumbnail", m_Columns.pixbuf);
     m_TreeView->set_size_request(Image::ThumbnailSize + 9, -1);
+
+    // Rows keep their height when a thumbnail hasn't been loaded yet or has been unloaded
+    Gtk::CellRenderer* cell{ m_TreeView->get_column_cell_renderer(0) };
+    int xpad, ypad;
+    cell->get_padding(xpad, ypad);
+    cell->set_fixed_size(-1, Image::ThumbnailSize + ypad * 2);
+
     m_CursorConn = m_TreeView->signal_cursor_changed().connect(
         sigc::mem_fun(*this, &ThumbnailBar::on_cursor_changed));
     m_TreeView->signal_button_press_event().connect(
@@ -30,6 +37,10 @@ ThumbnailBar::ThumbnailBar(BaseObjectType* cobj, const Glib::RefPtr<Gtk::Builder
     // called when thumbnails are being loaded
     m_ScrollConn =
         get_vadjustment()->signal_value_changed().connect([&]() { m_KeepAligned = false; });
+
+    get_vadjustment()->signal_value_changed().connect(
+        [&]() { m_SignalVisibleRangeChanged(); });
+    get_vadjustment()->signal_changed().connect([&]() { m_SignalVisibleRangeChanged(); });
 }
 
 void ThumbnailBar::clear()
@@ -38,12 +49,33 @@ void ThumbnailBar::clear()
     m_KeepAligned = true;
 }
 
-void ThumbnailBar::set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
+bool ThumbnailBar::get_visible_range(size_t& start, size_t& end) const
 {
+    Gtk::TreePath start_path, end_path;
+
+    if (!m_TreeView->get_visible_range(start_path, end_path))
+        return false;
+
+    start = start_path[0];
+    end   = end_path[0];
+
+    return true;
+}
+
+void ThumbnailBar::set_pixbufs(const std::vector<ImageList::PixbufPair>& pixbufs)
+{
+    // The tree view resizes the rows after this returns, which can change the
+    // adjustment's value.  Scroll events are ignored until that has happened
     m_ScrollConn.block();
-    ImageList::Widget::set_pixbuf(index, pixbuf);
-    while (Glib::MainContext::get_default()->pending())
-        Glib::MainContext::get_default()->iteration(true);
+    ImageList::Widget::set_pixbufs(pixbufs);
+
+    if (!m_AlignConn)
+        m_AlignConn = Glib::signal_idle().connect(
+            sigc::mem_fun(*this, &ThumbnailBar::on_pixbufs_set), Glib::PRIORITY_LOW);
+}
+
+bool ThumbnailBar::on_pixbufs_set()
+{
     m_ScrollConn.unblock();
 
     // Keep the selected image centered while thumbnails are being added
@@ -68,6 +100,8 @@ void ThumbnailBar::set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf
 
         get_window()->thaw_updates();
     }
+
+    return false;
 }
 
 void ThumbnailBar::on_realize()
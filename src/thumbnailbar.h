@@ -13,7 +13,8 @@ namespace AhoViewer
         ~ThumbnailBar() override = default;
 
         void clear() override;
-        void set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf>& pixbuf) override;
+        void set_pixbufs(const std::vector<ImageList::PixbufPair>& pixbufs) override;
+        bool get_visible_range(size_t& start, size_t& end) const override;
 
     protected:
         void on_realize() override;
@@ -25,11 +26,12 @@ namespace AhoViewer
     private:
         bool on_button_press_event(GdkEventButton* e) override;
         void on_cursor_changed();
+        bool on_pixbufs_set();
 
         Gtk::TreeView* m_TreeView;
         Gtk::Menu* m_PopupMenu;
         Glib::RefPtr<Gtk::Adjustment> m_VAdjust;
         bool m_KeepAligned{ true };
-        sigc::connection m_ScrollConn;
+        sigc::connection m_ScrollConn, m_AlignConn;
     };
 }
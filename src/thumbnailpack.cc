@@ -0,0 +1,418 @@
+#include "thumbnailpack.h"
+using namespace AhoViewer;
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstring>
+#include <glib/gstdio.h>
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+// All values are stored in native byte order, the pack is only a cache
+struct FileHeader
+{
+    char magic[4];
+    uint32_t version;
+};
+
+// Followed by name_length bytes of the filename and width * height * 4 bytes of RGBA pixels
+struct RecordHeader
+{
+    uint32_t name_length;
+    uint32_t width, height;
+    uint32_t reserved;
+    int64_t mtime, size;
+};
+
+static constexpr FileHeader PackHeader{ { 'A', 'H', 'T', 'P' }, 1 };
+// Anything larger than these is treated as a corrupt record
+static constexpr uint32_t MaxNameLength{ 4096 }, MaxDimension{ 1024 };
+
+const std::string ThumbnailPack::PackDir =
+    Glib::build_filename(Glib::get_user_cache_dir(), PACKAGE, "thumbnails");
+
+// Returns an empty string when the file doesn't exist (or the platform has no file IDs, on
+// Windows a file can't be replaced while another instance has it open anyway)
+static std::string file_id(const std::string& path)
+{
+    try
+    {
+        return Gio::File::create_for_path(path)
+            ->query_info(G_FILE_ATTRIBUTE_ID_FILE)
+            ->get_attribute_string(G_FILE_ATTRIBUTE_ID_FILE);
+    }
+    catch (const Glib::Error&)
+    {
+        return {};
+    }
+}
+
+static size_t record_size(const size_t name_length, const uint32_t w, const uint32_t h)
+{
+    return sizeof(RecordHeader) + name_length + static_cast<size_t>(w) * h * 4;
+}
+
+ThumbnailPack::ThumbnailPack(const std::string& dir_path)
+    : m_DirPath{ dir_path },
+      m_Path{ Glib::build_filename(
+          PackDir,
+          Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, dir_path) + ".pack") }
+{
+}
+
+ThumbnailPack::~ThumbnailPack()
+{
+    if (m_Mapped)
+        g_mapped_file_unref(m_Mapped);
+}
+
+Glib::RefPtr<Gdk::Pixbuf>
+ThumbnailPack::get(const std::string& name, const int64_t mtime, const int64_t size)
+{
+    std::scoped_lock lock{ m_Mutex };
+
+    if (!m_Opened)
+        open();
+
+    auto it{ m_Entries.find(name) };
+    if (it == m_Entries.end() || it->second.mtime != mtime || it->second.size != size)
+        return {};
+
+    // The entry was appended after the file was mapped
+    if (!m_Mapped || it->second.offset + static_cast<size_t>(it->second.width) * 4 *
+                                             it->second.height >
+                         g_mapped_file_get_length(m_Mapped))
+    {
+        if (!map())
+            return {};
+
+        // Another instance compacted the pack, the offsets are for the file it replaced
+        if (m_MappedId != m_FileId)
+        {
+            open();
+            it = m_Entries.find(name);
+
+            if (it == m_Entries.end() || it->second.mtime != mtime || it->second.size != size)
+                return {};
+        }
+    }
+
+    const Entry& e{ it->second };
+    const size_t row_bytes{ static_cast<size_t>(e.width) * 4 };
+
+    if (!m_Mapped || e.offset + row_bytes * e.height > g_mapped_file_get_length(m_Mapped))
+        return {};
+
+    auto pixbuf{ Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, e.width, e.height) };
+    const auto* src{ reinterpret_cast<const guint8*>(g_mapped_file_get_contents(m_Mapped)) +
+                     e.offset };
+    guint8* dest{ pixbuf->get_pixels() };
+
+    for (uint32_t y = 0; y < e.height; ++y)
+        std::memcpy(dest + y * pixbuf->get_rowstride(), src + y * row_bytes, row_bytes);
+
+    return pixbuf;
+}
+
+void ThumbnailPack::add(const std::string& name,
+                        const int64_t mtime,
+                        const int64_t size,
+                        const Glib::RefPtr<Gdk::Pixbuf>& pixbuf)
+{
+    if (!pixbuf || name.empty() || name.size() > MaxNameLength ||
+        pixbuf->get_bits_per_sample() != 8 ||
+        pixbuf->get_width() > static_cast<int>(MaxDimension) ||
+        pixbuf->get_height() > static_cast<int>(MaxDimension))
+        return;
+
+    auto rgba{ pixbuf->get_has_alpha() ? pixbuf : pixbuf->add_alpha(false, 0, 0, 0) };
+    const RecordHeader header{ static_cast<uint32_t>(name.size()),
+                               static_cast<uint32_t>(rgba->get_width()),
+                               static_cast<uint32_t>(rgba->get_height()),
+                               0,
+                               mtime,
+                               size };
+    const size_t row_bytes{ static_cast<size_t>(header.width) * 4 },
+        rec_size{ record_size(name.size(), header.width, header.height) };
+
+    std::scoped_lock lock{ m_Mutex };
+
+    if (!m_Opened)
+        open();
+
+    if (m_WriteFailed)
+        return;
+
+    // Another instance compacted the pack, anything appended to the file it replaced would
+    // be lost and the index is for that file
+    if (file_id(m_Path) != m_FileId)
+    {
+        m_Stream.reset();
+        open();
+    }
+
+    // The whole record (and the file header for a new file) is written at once, appends
+    // from other instances can only come before or after it
+    std::vector<guint8> buf;
+    buf.reserve(sizeof(PackHeader) + rec_size);
+
+    try
+    {
+        if (!m_Stream)
+        {
+            if (!Glib::file_test(PackDir, Glib::FILE_TEST_EXISTS))
+                g_mkdir_with_parents(PackDir.c_str(), 0700);
+
+            m_Stream = Gio::File::create_for_path(m_Path)->append_to(Gio::FILE_CREATE_PRIVATE);
+            auto info{ m_Stream->query_info(G_FILE_ATTRIBUTE_ID_FILE
+                                            "," G_FILE_ATTRIBUTE_STANDARD_SIZE) };
+            const std::string id{ info->get_attribute_string(G_FILE_ATTRIBUTE_ID_FILE) };
+
+            if (id != m_FileId)
+            {
+                // Replaced again since it was indexed, try again with the next thumbnail
+                if (info->get_size() != 0)
+                {
+                    m_Stream.reset();
+                    return;
+                }
+
+                m_Entries.clear();
+                m_StaleBytes = 0;
+                m_FileId     = id;
+            }
+
+            if (info->get_size() == 0)
+                buf.insert(buf.end(),
+                           reinterpret_cast<const guint8*>(&PackHeader),
+                           reinterpret_cast<const guint8*>(&PackHeader) + sizeof(PackHeader));
+        }
+
+        buf.insert(buf.end(),
+                   reinterpret_cast<const guint8*>(&header),
+                   reinterpret_cast<const guint8*>(&header) + sizeof(header));
+        buf.insert(buf.end(), name.begin(), name.end());
+        for (uint32_t y = 0; y < header.height; ++y)
+        {
+            const guint8* row{ rgba->get_pixels() + y * rgba->get_rowstride() };
+            buf.insert(buf.end(), row, row + row_bytes);
+        }
+
+        gsize written{ 0 };
+        m_Stream->write_all(buf.data(), buf.size(), written);
+    }
+    catch (const Glib::Error& ex)
+    {
+        // A partial record will be removed by compact the next time the pack is cleaned
+        std::cerr << "ThumbnailPack: Failed to write to '" << m_Path << "'" << std::endl
+                  << ex.what() << std::endl;
+        m_Stream.reset();
+        m_WriteFailed = true;
+        return;
+    }
+
+    auto it{ m_Entries.find(name) };
+    if (it != m_Entries.end())
+        m_StaleBytes += record_size(name.size(), it->second.width, it->second.height);
+
+    // The stream's position is where this record ended, wherever other instances' records
+    // put it in the file
+    m_Entries[name] = { static_cast<size_t>(m_Stream->tell()) - rec_size + sizeof(header) +
+                            name.size(),
+                        mtime,
+                        size,
+                        header.width,
+                        header.height };
+}
+
+// Reads the index of the pack file, must be called with m_Mutex locked
+void ThumbnailPack::open()
+{
+    m_Opened = true;
+    m_Entries.clear();
+    m_StaleBytes = 0;
+    m_Corrupt    = false;
+    m_FileId.clear();
+
+    if (!Glib::file_test(m_Path, Glib::FILE_TEST_EXISTS) || !map())
+        return;
+
+    m_FileId = m_MappedId;
+
+    const size_t length{ g_mapped_file_get_length(m_Mapped) };
+    const auto* data{ reinterpret_cast<const guint8*>(g_mapped_file_get_contents(m_Mapped)) };
+    size_t pos{ sizeof(FileHeader) };
+
+    if (length < sizeof(FileHeader) || std::memcmp(data, &PackHeader, sizeof(PackHeader)) != 0)
+    {
+        // Unknown version or not a pack file at all, start over
+        g_mapped_file_unref(m_Mapped);
+        m_Mapped = nullptr;
+        m_Stream.reset();
+        g_remove(m_Path.c_str());
+        m_FileId.clear();
+        return;
+    }
+
+    while (pos + sizeof(RecordHeader) <= length)
+    {
+        RecordHeader header;
+        std::memcpy(&header, data + pos, sizeof(header));
+
+        if (header.name_length == 0 || header.name_length > MaxNameLength ||
+            header.width > MaxDimension || header.height > MaxDimension)
+            break;
+
+        const size_t rec_size{ record_size(header.name_length, header.width, header.height) };
+        if (pos + rec_size > length)
+            break;
+
+        std::string name(reinterpret_cast<const char*>(data + pos + sizeof(header)),
+                         header.name_length);
+        auto it{ m_Entries.find(name) };
+
+        if (it != m_Entries.end())
+            m_StaleBytes += record_size(name.size(), it->second.width, it->second.height);
+
+        m_Entries[name] = { pos + sizeof(header) + header.name_length,
+                            header.mtime,
+                            header.size,
+                            header.width,
+                            header.height };
+        pos += rec_size;
+    }
+
+    // The end of the file is corrupt (e.g. the last write was interrupted), clean removes it
+    m_Corrupt = pos != length;
+}
+
+// Scans the directory before locking so workers loading thumbnails from the pack are only
+// blocked when it has to be compacted
+void ThumbnailPack::clean()
+{
+    std::unordered_set<std::string> names;
+    try
+    {
+        for (const std::string& n : Glib::Dir{ m_DirPath })
+            names.insert(n);
+    }
+    catch (const Glib::FileError&)
+    {
+        return;
+    }
+
+    std::scoped_lock lock{ m_Mutex };
+
+    // Reread the index so it matches the file as it is mapped now, thumbnails that were
+    // appended after the last time it was mapped would be left out of the compacted file
+    open();
+
+    if (!m_Mapped || m_FileId.empty())
+        return;
+
+    // Files that were removed or renamed since their thumbnails were added
+    for (auto it = m_Entries.begin(); it != m_Entries.end();)
+    {
+        if (names.count(it->first))
+        {
+            ++it;
+            continue;
+        }
+
+        m_StaleBytes += record_size(it->first.size(), it->second.width, it->second.height);
+        it = m_Entries.erase(it);
+    }
+
+    if (m_Corrupt || m_StaleBytes > g_mapped_file_get_length(m_Mapped) / 2)
+        compact();
+}
+
+bool ThumbnailPack::map()
+{
+    if (m_Mapped)
+        g_mapped_file_unref(m_Mapped);
+
+    GError* error{ nullptr };
+    // Another instance could replace the file in between, then the ID wouldn't belong to
+    // the file that was mapped
+    std::string id{ file_id(m_Path) };
+    for (int i = 0; i < 3; ++i)
+    {
+        m_Mapped = g_mapped_file_new(m_Path.c_str(), FALSE, &error);
+        m_MappedId = file_id(m_Path);
+
+        if (error || m_MappedId == id)
+            break;
+
+        g_mapped_file_unref(m_Mapped);
+        m_Mapped = nullptr;
+        id       = m_MappedId;
+    }
+
+    if (error)
+    {
+        std::cerr << "ThumbnailPack: Failed to map '" << m_Path << "'" << std::endl
+                  << error->message << std::endl;
+        g_error_free(error);
+        m_Mapped = nullptr;
+    }
+
+    return m_Mapped != nullptr;
+}
+
+// Rewrites the pack file with only the latest entry of each filename.  The temporary file
+// has a unique name so instances that compact at the same time don't write into each other's
+void ThumbnailPack::compact()
+{
+    std::string tmp_path{ m_Path + ".XXXXXX" };
+    const int fd{ g_mkstemp(&tmp_path[0]) };
+    const auto* data{ reinterpret_cast<const guint8*>(g_mapped_file_get_contents(m_Mapped)) };
+    FILE* f{ fd == -1 ? nullptr : fdopen(fd, "wb") };
+    bool ok{ f && fwrite(&PackHeader, sizeof(PackHeader), 1, f) == 1 };
+    size_t pos{ sizeof(PackHeader) };
+
+    if (fd != -1 && !f)
+        g_close(fd, nullptr);
+
+    for (auto it = m_Entries.begin(); ok && it != m_Entries.end(); ++it)
+    {
+        Entry& e{ it->second };
+        const size_t rec_size{ record_size(it->first.size(), e.width, e.height) },
+            start{ e.offset - sizeof(RecordHeader) - it->first.size() };
+
+        ok       = fwrite(data + start, rec_size, 1, f) == 1;
+        e.offset = pos + sizeof(RecordHeader) + it->first.size();
+        pos += rec_size;
+    }
+
+    if (f)
+        ok = fclose(f) == 0 && ok;
+
+    g_mapped_file_unref(m_Mapped);
+    m_Mapped = nullptr;
+    // Still appending to the file that is about to be replaced
+    m_Stream.reset();
+
+    // Renaming over an existing file fails on Windows
+    if (ok && g_rename(tmp_path.c_str(), m_Path.c_str()) != 0)
+        ok = g_remove(m_Path.c_str()) == 0 && g_rename(tmp_path.c_str(), m_Path.c_str()) == 0;
+
+    if (!ok)
+    {
+        std::cerr << "ThumbnailPack: Failed to compact '" << m_Path << "'" << std::endl;
+        if (fd != -1)
+            g_remove(tmp_path.c_str());
+        g_remove(m_Path.c_str());
+        m_Entries.clear();
+        m_FileId.clear();
+    }
+    else if (map())
+    {
+        m_FileId = m_MappedId;
+    }
+
+    m_StaleBytes = 0;
+    m_Corrupt    = false;
+}
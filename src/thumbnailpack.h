@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <gdkmm.h>
+#include <giomm.h>
+#include <glibmm.h>
+#include <mutex>
+#include <unordered_map>
+
+namespace AhoViewer
+{
+    // A single append-only file per directory that holds the thumbnails of the images in
+    // it as raw RGBA pixels.  The file is mapped into memory and indexed by filename, an
+    // entry is only used when the mtime and size it was created for match the image file.
+    //
+    // Pack files are stored in $XDG_CACHE_HOME/ahoviewer/thumbnails, named after the MD5
+    // of the directory's path.  Replaced thumbnails are appended to the end of the file and
+    // the file is compacted by clean when it mostly contains stale entries, entries of files
+    // that are no longer in the directory are stale too.
+    //
+    // Several instances can have the same pack open.  Records are appended with a single
+    // write so they don't interleave, and when another instance has compacted the pack (the
+    // path is a different file than the one that was indexed) the new file is reindexed
+    // before anything is read from or appended to it.
+    class ThumbnailPack
+    {
+    public:
+        ThumbnailPack(const std::string& dir_path);
+        ~ThumbnailPack();
+
+        // Returns a copy of the thumbnail for name, or a null RefPtr if there is no
+        // entry or it is out of date.  The pack file is read on the first call
+        Glib::RefPtr<Gdk::Pixbuf>
+        get(const std::string& name, const int64_t mtime, const int64_t size);
+        void add(const std::string& name,
+                 const int64_t mtime,
+                 const int64_t size,
+                 const Glib::RefPtr<Gdk::Pixbuf>& pixbuf);
+        // Drops the entries of files that are no longer in the directory and compacts the
+        // pack when the end of it is corrupt or it mostly holds stale entries.  Reads the
+        // directory so it should be run on a background task
+        void clean();
+
+        static const std::string PackDir;
+
+    private:
+        struct Entry
+        {
+            size_t offset; // Offset of the pixel data
+            int64_t mtime, size;
+            uint32_t width, height;
+        };
+
+        void open();
+        bool map();
+        void compact();
+
+        std::string m_DirPath, m_Path;
+        std::mutex m_Mutex;
+        bool m_Opened{ false }, m_WriteFailed{ false }, m_Corrupt{ false };
+
+        GMappedFile* m_Mapped{ nullptr };
+        Glib::RefPtr<Gio::FileOutputStream> m_Stream;
+        // G_FILE_ATTRIBUTE_ID_FILE of the file that is mapped and of the one m_Entries
+        // belongs to
+        std::string m_MappedId, m_FileId;
+        size_t m_StaleBytes{ 0 };
+
+        std::unordered_map<std::string, Entry> m_Entries;
+    };
+}
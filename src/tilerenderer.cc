@@ -0,0 +1,157 @@
+#include "tilerenderer.h"
+using namespace AhoViewer;
+
+#include <algorithm>
+#include <cmath>
+
+void TileRenderer::set_pixbuf(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf,
+                              const std::vector<Glib::RefPtr<Gdk::Pixbuf>>& mipmaps)
+{
+    if (pixbuf == m_Pixbuf && mipmaps.size() + 1 == m_Levels.size())
+        return;
+
+    clear();
+
+    m_Pixbuf = pixbuf;
+    if (m_Pixbuf)
+    {
+        m_Levels.push_back(m_Pixbuf);
+        m_Levels.insert(m_Levels.end(), mipmaps.begin(), mipmaps.end());
+    }
+}
+
+void TileRenderer::clear()
+{
+    m_Pixbuf.reset();
+    m_Levels.clear();
+    m_LRU.clear();
+    m_Tiles.clear();
+    m_CacheBytes = 0;
+}
+
+bool TileRenderer::draw(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+    if (!m_Pixbuf)
+        return false;
+
+    const size_t level{ get_level() };
+    const Glib::RefPtr<Gdk::Pixbuf>& pixbuf{ m_Levels[level] };
+    // Scale from the level's pixels to the widget's
+    const double scale{ m_Scale * m_Pixbuf->get_width() / pixbuf->get_width() };
+    const int cols{ (pixbuf->get_width() + TileSize - 1) / TileSize },
+        rows{ (pixbuf->get_height() + TileSize - 1) / TileSize };
+
+    double x1, y1, x2, y2;
+    cr->get_clip_extents(x1, y1, x2, y2);
+
+    const int c1{ std::clamp(static_cast<int>(x1 / scale) / TileSize, 0, cols - 1) },
+        c2{ std::clamp(static_cast<int>(std::ceil(x2 / scale)) / TileSize, 0, cols - 1) },
+        r1{ std::clamp(static_cast<int>(y1 / scale) / TileSize, 0, rows - 1) },
+        r2{ std::clamp(static_cast<int>(std::ceil(y2 / scale)) / TileSize, 0, rows - 1) };
+
+    size_t frame_bytes{ 0 };
+
+    cr->save();
+    // Antialiasing the tile edges would leave visible seams between them
+    cr->set_antialias(Cairo::ANTIALIAS_NONE);
+    cr->scale(scale, scale);
+
+    for (int row = r1; row <= r2; ++row)
+    {
+        for (int col = c1; col <= c2; ++col)
+        {
+            const Tile& tile{ get_tile(level, col, row) };
+            const int x{ col * TileSize }, y{ row * TileSize },
+                w{ std::min(TileSize, pixbuf->get_width() - x) },
+                h{ std::min(TileSize, pixbuf->get_height() - y) };
+
+            auto pattern{ Cairo::SurfacePattern::create(tile.surface) };
+            pattern->set_matrix(
+                Cairo::translation_matrix(tile.border_x - x, tile.border_y - y));
+            // The border covers the edges shared with other tiles, pad the image's own edges
+            // so they are filtered against themselves instead of transparency
+            pattern->set_extend(Cairo::EXTEND_PAD);
+            pattern->set_filter(Cairo::FILTER_BILINEAR);
+
+            cr->set_source(pattern);
+            cr->rectangle(x, y, w, h);
+            cr->fill();
+
+            frame_bytes +=
+                static_cast<size_t>(tile.surface->get_stride()) * tile.surface->get_height();
+        }
+    }
+
+    cr->restore();
+    evict_tiles(frame_bytes);
+
+    return true;
+}
+
+// Returns the smallest level that is still drawn at the same size or larger
+size_t TileRenderer::get_level()
+{
+    size_t level{ 0 };
+    const int w{ static_cast<int>(std::ceil(m_Pixbuf->get_width() * m_Scale)) },
+        h{ static_cast<int>(std::ceil(m_Pixbuf->get_height() * m_Scale)) };
+
+    while (level + 1 < m_Levels.size() && m_Levels[level + 1]->get_width() >= w &&
+           m_Levels[level + 1]->get_height() >= h)
+        ++level;
+
+    return level;
+}
+
+const TileRenderer::Tile&
+TileRenderer::get_tile(const size_t level, const int col, const int row)
+{
+    const uint64_t key{ tile_key(level, col, row) };
+    auto it{ m_Tiles.find(key) };
+
+    if (it != m_Tiles.end())
+    {
+        m_LRU.splice(m_LRU.begin(), m_LRU, it->second.lru);
+        return it->second;
+    }
+
+    const Glib::RefPtr<Gdk::Pixbuf>& pixbuf{ m_Levels[level] };
+    const int x{ col * TileSize }, y{ row * TileSize },
+        // Extend the tile by a pixel on each side that has a neighboring tile
+        x1{ std::max(x - 1, 0) }, y1{ std::max(y - 1, 0) },
+        x2{ std::min(x + TileSize + 1, pixbuf->get_width()) },
+        y2{ std::min(y + TileSize + 1, pixbuf->get_height()) };
+
+    auto surface{ Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, x2 - x1, y2 - y1) };
+    {
+        // Using a subpixbuf means only this tile's pixels are converted
+        auto ctx{ Cairo::Context::create(surface) };
+        Gdk::Cairo::set_source_pixbuf(
+            ctx, Gdk::Pixbuf::create_subpixbuf(pixbuf, x1, y1, x2 - x1, y2 - y1), 0, 0);
+        ctx->paint();
+    }
+
+    m_LRU.push_front(key);
+    m_CacheBytes += static_cast<size_t>(surface->get_stride()) * surface->get_height();
+
+    Tile& tile{ m_Tiles[key] };
+    tile = { surface, m_LRU.begin(), x - x1, y - y1 };
+
+    return tile;
+}
+
+void TileRenderer::evict_tiles(const size_t frame_bytes)
+{
+    // Room for the visible tiles and about as many around them so scrolling back doesn't
+    // recreate them, but bounded however large the window is
+    const size_t max_bytes{ std::clamp(frame_bytes * 2, MaxCacheBytes, MaxCacheBytes * 4) };
+
+    while (m_CacheBytes > max_bytes && !m_LRU.empty())
+    {
+        auto it{ m_Tiles.find(m_LRU.back()) };
+
+        m_CacheBytes -= static_cast<size_t>(it->second.surface->get_stride()) *
+                        it->second.surface->get_height();
+        m_Tiles.erase(it);
+        m_LRU.pop_back();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <gdkmm.h>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace AhoViewer
+{
+    // Draws a pixbuf at any scale by only painting the tiles that intersect the
+    // cairo clip region.  This is used by the ImageBox for images that are drawn much
+    // larger than the window, instead of scaling the whole pixbuf.
+    //
+    // Tiles are cairo image surfaces created on demand from the source pixbuf, or one of
+    // the Image's mipmaps when zoomed out, and are kept in an LRU cache.  Each surface has a
+    // 1px border of its neighbors' pixels so filtering across tile edges doesn't leave seams.
+    // The cache is limited to MaxCacheBytes, or twice the size of the visible tiles on large
+    // windows up to MaxCacheBytes * 4
+    class TileRenderer
+    {
+    public:
+        TileRenderer() = default;
+        ~TileRenderer() = default;
+
+        // Resets the tile cache if pixbuf or its mipmaps are different from the current ones.
+        // Until mipmaps are available every tile is scaled from pixbuf
+        void set_pixbuf(const Glib::RefPtr<Gdk::Pixbuf>& pixbuf,
+                        const std::vector<Glib::RefPtr<Gdk::Pixbuf>>& mipmaps);
+        // The scale the source pixbuf is drawn at, 1.0 is the pixbuf's size
+        void set_scale(const double scale) { m_Scale = scale; }
+        void clear();
+
+        bool empty() const { return !m_Pixbuf; }
+
+        // Paints the tiles that are inside cr's clip extents, returns false if there
+        // is nothing to draw
+        bool draw(const Cairo::RefPtr<Cairo::Context>& cr);
+
+        static constexpr int TileSize{ 256 };
+        static constexpr size_t MaxCacheBytes{ 64 * 1024 * 1024 };
+
+    private:
+        struct Tile
+        {
+            Cairo::RefPtr<Cairo::ImageSurface> surface;
+            std::list<uint64_t>::iterator lru;
+            // Position of the tile's first pixel inside of surface
+            int border_x, border_y;
+        };
+
+        static uint64_t tile_key(const size_t level, const int col, const int row)
+        {
+            return (static_cast<uint64_t>(level) << 48) | (static_cast<uint64_t>(row) << 24) |
+                   static_cast<uint64_t>(col);
+        }
+
+        size_t get_level();
+        const Tile& get_tile(const size_t level, const int col, const int row);
+        // frame_bytes is the size of the tiles that were just drawn
+        void evict_tiles(const size_t frame_bytes);
+
+        Glib::RefPtr<Gdk::Pixbuf> m_Pixbuf;
+        // Index 0 is m_Pixbuf followed by its mipmaps, each half the size of the previous
+        std::vector<Glib::RefPtr<Gdk::Pixbuf>> m_Levels;
+        double m_Scale{ 1.0 };
+
+        // Most recently used tiles are at the front
+        std::list<uint64_t> m_LRU;
+        std::unordered_map<uint64_t, Tile> m_Tiles;
+        size_t m_CacheBytes{ 0 };
+    };
+}
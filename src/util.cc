@@ -2,9 +2,42 @@
 
 #include "settings.h"
 
+#include <cmath>
 #include <date/tz.h>
 #include <glibmm/i18n.h>
 
+namespace AhoViewer
+{
+    void DisplayArea::get_scaled_size(const int orig_w, const int orig_h, int& w, int& h) const
+    {
+        w = orig_w;
+        h = orig_h;
+
+        double window_aspect = static_cast<double>(width) / height,
+               image_aspect  = static_cast<double>(w) / h;
+
+        // These do not take the scrollbar size in to account, because I assume that
+        // overlay scrollbars are enabled
+        if (w > width && (zoom_mode == ZoomMode::FIT_WIDTH ||
+                          (zoom_mode == ZoomMode::AUTO_FIT && window_aspect <= image_aspect)))
+        {
+            w = width;
+            h = std::ceil(w / image_aspect);
+        }
+        else if (h > height && (zoom_mode == ZoomMode::FIT_HEIGHT ||
+                                (zoom_mode == ZoomMode::AUTO_FIT && window_aspect >= image_aspect)))
+        {
+            h = height;
+            w = std::ceil(h * image_aspect);
+        }
+        else if (zoom_mode == ZoomMode::MANUAL && zoom_percent != 100)
+        {
+            w *= static_cast<double>(zoom_percent) / 100;
+            h *= static_cast<double>(zoom_percent) / 100;
+        }
+    }
+}
+
 namespace AhoViewer::Util
 {
     std::wstring utf8_to_utf16(const std::string& s)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <date/date.h>
 #include <gdkmm.h>
 #include <glibmm.h>
@@ -55,6 +56,33 @@ namespace AhoViewer
         double h, v;
         ZoomMode zoom;
     };
+    // The size of the area images are drawn in and the zoom used by the ImageBox,
+    // this is used to scale images before they are shown
+    struct DisplayArea
+    {
+        int width{ 0 }, height{ 0 };
+        ZoomMode zoom_mode{ ZoomMode::AUTO_FIT };
+        uint32_t zoom_percent{ 100 };
+
+        bool valid() const { return width > 0 && height > 0; }
+        // Sets w and h to the size an image of orig_w x orig_h is drawn at
+        void get_scaled_size(const int orig_w, const int orig_h, int& w, int& h) const;
+        // Images drawn at w x h are only drawn in tiles by the ImageBox, instead of scaling the
+        // whole image, when they are much larger than the area
+        bool use_tiles(const int w, const int h) const
+        {
+            return valid() && static_cast<int64_t>(w) * h >
+                                  static_cast<int64_t>(width) * height * TileAreaFactor;
+        }
+        static constexpr int TileAreaFactor{ 4 };
+
+        inline bool operator==(const DisplayArea& rhs) const
+        {
+            return width == rhs.width && height == rhs.height && zoom_mode == rhs.zoom_mode &&
+                   zoom_percent == rhs.zoom_percent;
+        }
+        inline bool operator!=(const DisplayArea& rhs) const { return !(*this == rhs); }
+    };
 
     namespace Booru
     {